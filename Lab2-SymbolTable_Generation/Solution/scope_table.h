@@ -1,4 +1,8 @@
 #include "symbol_info.h"
+#include "../../common/scoped_map.h"
+
+// Symbols of every open scope live in one ScopedMap owned by symbol_table
+typedef ScopedMap<string, unique_ptr<symbol_info>, fnv1a_hash, binding_stack_storage> symbol_map;
 
 class scope_table
 {
@@ -6,9 +10,11 @@ private:
     int bucket_count;
     int unique_id;
     scope_table *parent_scope = NULL;
-    vector<list<symbol_info *>> table;
+    symbol_map *symbols; // shared with the other open scopes
+    int level;           // this scope's level in symbols
 
-    int hash_function(string name)
+    // decides the bucket a symbol is printed under
+    int hash_function(string_view name)
     {
         unsigned long hash = 0;
         for (char c : name)
@@ -19,110 +25,60 @@ private:
     }
 
 public:
-    scope_table() : bucket_count(0), unique_id(0), parent_scope(NULL) {}
+    scope_table() : bucket_count(0), unique_id(0), parent_scope(NULL), symbols(NULL), level(0) {}
     
-    scope_table(int bucket_count, int unique_id, scope_table *parent_scope)
+    scope_table(int bucket_count, int unique_id, scope_table *parent_scope, symbol_map *symbols, int level)
     {
         this->bucket_count = bucket_count;
         this->unique_id = unique_id;
         this->parent_scope = parent_scope;
-        table.resize(bucket_count);
+        this->symbols = symbols;
+        this->level = level;
     }
 
     scope_table *get_parent_scope() { return parent_scope; }
     int get_unique_id() { return unique_id; }
 
-    symbol_info *lookup_in_scope(symbol_info* symbol)
-    {
-        int idx = hash_function(symbol->get_name());
-        for (auto it = table[idx].begin(); it != table[idx].end(); ++it)
-        {
-            if ((*it)->get_name() == symbol->get_name())
-            {
-                return *it;
-            }
-        }
-        return NULL;
-    }
-    
-    // Overload to lookup by name string
-    symbol_info *lookup_in_scope(string name)
-    {
-        int idx = hash_function(name);
-        for (auto it = table[idx].begin(); it != table[idx].end(); ++it)
-        {
-            if ((*it)->get_name() == name)
-            {
-                return *it;
-            }
-        }
-        return NULL;
-    }
-
-    bool insert_in_scope(symbol_info* symbol)
-    {
-        if (lookup_in_scope(symbol->get_name()) != NULL) return false;
-        int idx = hash_function(symbol->get_name());
-        table[idx].push_back(symbol);
-        return true;
-    }
-
-    bool delete_from_scope(symbol_info* symbol)
-    {
-        int idx = hash_function(symbol->get_name());
-        for (auto it = table[idx].begin(); it != table[idx].end(); ++it)
-        {
-            if ((*it)->get_name() == symbol->get_name())
-            {
-                delete *it; 
-                table[idx].erase(it);
-                return true;
-            }
-        }
-        return false;
-    }
-
     void print_scope_table(ofstream& outlog);
-
-    ~scope_table()
-    {
-        for(int i=0; i<bucket_count; i++) {
-            for(auto s : table[i]) {
-                delete s;
-            }
-        }
-    }
 };
 
 void scope_table::print_scope_table(ofstream& outlog)
 {
+    // group by bucket, keeping insertion order inside a bucket
+    vector<pair<int, symbol_info*>> table;
+    symbols->for_each_in_scope(level, [&](const string &name, unique_ptr<symbol_info> &s) {
+        table.emplace_back(hash_function(name), s.get());
+    });
+    stable_sort(table.begin(), table.end(), [](const pair<int, symbol_info*> &a, const pair<int, symbol_info*> &b) {
+        return a.first < b.first;
+    });
+
     outlog << "ScopeTable # "+ to_string(unique_id) << endl;
-    for(int i=0; i<bucket_count; i++) {
-        if(table[i].empty()) continue;
-        outlog << i << " --> " << endl;
-        for(auto s : table[i]) {
-            outlog << "< " << s->get_name() << " : " << s->get_type() << " >" << endl;
+    for(size_t k=0; k<table.size(); k++) {
+        int i = table[k].first;
+        if(k == 0 || table[k-1].first != i) outlog << i << " --> " << endl;
+        symbol_info *s = table[k].second;
+        outlog << "< " << s->get_name() << " : " << s->get_type() << " >" << endl;
             
-            if(s->get_id_type() == "var") {
-                outlog << "Variable" << endl;
-                outlog << "Type: " << s->get_data_type() << endl;
-            } else if(s->get_id_type() == "array") {
-                outlog << "Array" << endl;
-                outlog << "Type: " << s->get_data_type() << endl;
-                outlog << "Size: " << s->get_array_size() << endl;
-            } else if(s->get_id_type() == "func") {
-                outlog << "Function Definition" << endl;
-                outlog << "Return Type: " << s->get_return_type() << endl;
-                outlog << "Number of Parameters: " << s->get_parameters().size() << endl;
-                outlog << "Parameter Details: ";
-                auto params = s->get_parameters();
-                for(size_t j=0; j<params.size(); j++) {
-                    outlog << params[j].first << " " << params[j].second;
-                    if(j < params.size()-1) outlog << ", ";
-                }
-                outlog << endl;
+        if(s->get_id_type() == "var") {
+            outlog << "Variable" << endl;
+            outlog << "Type: " << s->get_data_type() << endl;
+        } else if(s->get_id_type() == "array") {
+            outlog << "Array" << endl;
+            outlog << "Type: " << s->get_data_type() << endl;
+            outlog << "Size: " << s->get_array_size() << endl;
+        } else if(s->get_id_type() == "func") {
+            outlog << "Function Definition" << endl;
+            outlog << "Return Type: " << s->get_return_type() << endl;
+            outlog << "Number of Parameters: " << s->get_parameters().size() << endl;
+            outlog << "Parameter Details: ";
+            auto params = s->get_parameters();
+            for(size_t j=0; j<params.size(); j++) {
+                outlog << params[j].first << " " << params[j].second;
+                if(j < params.size()-1) outlog << ", ";
             }
             outlog << endl;
         }
+        outlog << endl;
     }
 }
@@ -3,6 +3,7 @@
 class symbol_table
 {
 private:
+    symbol_map symbols;
     scope_table *current_scope;
     int bucket_count;
     int current_scope_id;
@@ -27,7 +28,8 @@ public:
     void enter_scope(ofstream& outlog)
     {
         current_scope_id++;
-        scope_table *new_scope = new scope_table(bucket_count, current_scope_id, current_scope);
+        symbols.enter_scope(bucket_count);
+        scope_table *new_scope = new scope_table(bucket_count, current_scope_id, current_scope, &symbols, symbols.depth() - 1);
         current_scope = new_scope;
         outlog << "New ScopeTable with ID " << current_scope_id << " created" << endl << endl;
     }
@@ -37,38 +39,27 @@ public:
         if (current_scope == NULL) return;
         scope_table *parent = current_scope->get_parent_scope();
         outlog << "Scopetable with ID " << current_scope->get_unique_id() << " removed" << endl << endl;
+        symbols.exit_scope();
         delete current_scope;
         current_scope = parent;
     }
 
+    // takes ownership of symbol if it was inserted; otherwise the caller keeps it
     bool insert(symbol_info* symbol)
     {
         if (current_scope == NULL) return false;
-        return current_scope->insert_in_scope(symbol);
+        return symbols.try_emplace(symbol->get_name(), [&] { return unique_ptr<symbol_info>(symbol); }) != NULL;
     }
 
     symbol_info* lookup(symbol_info* symbol)
     {
-        scope_table *temp = current_scope;
-        while (temp != NULL)
-        {
-            symbol_info *found = temp->lookup_in_scope(symbol);
-            if (found != NULL) return found;
-            temp = temp->get_parent_scope();
-        }
-        return NULL;
+        return lookup(symbol->get_name());
     }
     
-    symbol_info* lookup(string name)
+    symbol_info* lookup(string_view name)
     {
-        scope_table *temp = current_scope;
-        while (temp != NULL)
-        {
-            symbol_info *found = temp->lookup_in_scope(name);
-            if (found != NULL) return found;
-            temp = temp->get_parent_scope();
-        }
-        return NULL;
+        unique_ptr<symbol_info> *found = symbols.find(name);
+        return found ? found->get() : NULL;
     }
 
     void print_current_scope(ofstream& outlog)
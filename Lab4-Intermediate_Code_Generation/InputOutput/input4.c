@@ -0,0 +1,29 @@
+int g[20];
+
+int sum(int n) {
+    int a[20];
+    int i, s, k, m;
+    k = 3;
+    m = 4;
+    s = 0;
+    for (i = 0; i < n; i++) {
+        a[i] = k * m + i;
+    }
+    i = 0;
+    while (i < n) {
+        s = s + a[i] * 2;
+        g[i] = s;
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    int x, y, z;
+    x = 5;
+    y = x;
+    z = y + x;
+    z = y + x;
+    x = sum(z);
+    return x;
+}
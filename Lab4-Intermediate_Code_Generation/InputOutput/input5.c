@@ -0,0 +1,32 @@
+int count;
+
+int square(int v) {
+    return v * v;
+}
+
+int fact(int n) {
+    if (n < 2) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+
+int main() {
+    int a, b, c, i;
+    a = 3;
+    b = 0;
+    c = square(a) + square(a + 1);
+    if (a > 1 && b < 1) {
+        c = c + 1;
+    } else {
+        c = c - 1;
+    }
+    while (a > 0 || b < 5) {
+        a--;
+        b = b + 2;
+    }
+    for (i = 0; i < 10 && !(c == 0); i++) {
+        count = count + fact(i);
+    }
+    return c;
+}
@@ -0,0 +1,33 @@
+int total;
+
+int mix(int p, int q) {
+    int r, s, t, u;
+    r = p * q + p;
+    s = p * q + p;
+    t = r;
+    u = t + s;
+    r = u - 1;
+    return u;
+}
+
+int grid(int w, int h) {
+    int x, y, acc, unused;
+    acc = 0;
+    unused = w * h;
+    for (y = 0; y < h; y++) {
+        x = 0;
+        while (x < w) {
+            acc = acc + w * h + y;
+            total = total + x;
+            x++;
+        }
+    }
+    return acc;
+}
+
+int main() {
+    int a, b;
+    a = mix(2, 3);
+    b = grid(a, 4);
+    return b;
+}
@@ -4,553 +4,569 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <fstream>
-#include <map>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <utility>
+#include <new>
 
 using namespace std;
 
-class ASTNode {
-public:
-    virtual ~ASTNode() {}
-    virtual string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp, int &temp_count, int &label_count) const = 0;
+// Flat AST.
+//
+// Every node is a 32-bit index into one ASTArena. The arena keeps a compact
+// header per node (kind, type, slot) and stores the payload of each kind in its
+// own contiguous array, so building a node is a push_back, the whole tree is
+// freed with the arena, and a pass over one kind walks memory sequentially.
+// Identifiers, literals and operators are interned once and referred to by id.
+// Optionally, repeated pure subexpressions share one node (set_hash_consing).
+// Node 0 is reserved so that a zero id means "no node".
+
+typedef uint32_t node_id;
+typedef uint32_t str_id;
+
+const node_id NO_NODE = 0;
+
+enum class NodeKind : uint8_t {
+    NONE,
+    // expressions
+    VAR, CONST, BINARY_OP, UNARY_OP, ASSIGN, FUNC_CALL,
+    // statements
+    EXPR_STMT, BLOCK, IF, WHILE, FOR, RETURN, DECL,
+    // top level and helpers
+    FUNC_DECL, ARGUMENTS, PROGRAM
 };
 
-// Expression node types
-
-class ExprNode : public ASTNode {
-protected:
-    string node_type; // Type information (int, float, void, etc.)
-public:
-    ExprNode(string type) : node_type(type) {}
-    virtual string get_type() const { return node_type; }
-};
+inline bool is_expr(NodeKind k) { return k >= NodeKind::VAR && k <= NodeKind::FUNC_CALL; }
+inline bool is_stmt(NodeKind k) { return k >= NodeKind::EXPR_STMT && k <= NodeKind::DECL; }
 
-// Variable node (for ID references)
+// Bytes per element of a variable of the given type
+inline uint32_t element_size(const string &type) { return (type == "float" || type == "double") ? 8 : 4; }
 
-class VarNode : public ExprNode {
-private:
-    string name;
-    ExprNode *index; // For array access, nullptr for simple variables
+// Per-node flags set by passes for later ones
+enum NodeFlag : uint8_t {
+    RIGHT_FIRST = 1 << 0, // binary operator: evaluate the right operand first
+};
 
-public:
-    VarNode(string name, string type, ExprNode *idx = nullptr)
-        : ExprNode(type), name(name), index(idx) {}
-
-    ~VarNode() { if(index) delete index; }
-
-    bool has_index() const { return index != nullptr; }
-
-    string generate_index_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                               int &temp_count, int &label_count) const {
-        // TODO: Implement this method
-        // Should generate code to calculate the array index and return the temp variable
-        if (!index) return "";
-        string index_temp = index->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        int scale = (node_type == "float" || node_type == "double") ? 8 : 4;
-        string scale_temp = "t" + to_string(temp_count++);
-        outcode << scale_temp << " = " << scale << endl;
-        string offset_temp = "t" + to_string(temp_count++);
-        outcode << offset_temp << " = " << index_temp << " * " << scale_temp << endl;
-        return offset_temp;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for variable access or array access
-        string temp = "t" + to_string(temp_count++);
-
-        if (!index && symbol_to_temp.find(name) != symbol_to_temp.end()) {
-             return symbol_to_temp[name];
-        }
+struct NodeHeader {
+    NodeKind kind;
+    uint8_t flags;  // NodeFlag bits
+    uint16_t type;  // index into the type table (int, float, void, error, ...)
+    uint32_t slot;  // index into the array for this kind
+};
 
-        if (index) {
-            string offset = generate_index_code(outcode, symbol_to_temp, temp_count, label_count);
-            outcode << temp << " = " << name << "[" << offset << "]" << endl;
-        } else {
-            outcode << temp << " = " << name << endl;
-            symbol_to_temp[name] = temp;
-        }
-        return temp;
-    }
+// Singly linked list of nodes for children that arrive one at a time
+// (block statements, call arguments, program units)
+struct NodeList {
+    uint32_t first = 0, last = 0, count = 0; // cells are 1-based, 0 ends the list
+};
 
-    string get_name() const { return name; }
+struct ListCell {
+    node_id item;
+    uint32_t next;
 };
 
-// Constant node
+// Per-kind payloads
 
-class ConstNode : public ExprNode {
-private:
-    string value;
+struct VarNode {
+    str_id name;
+    node_id index; // for array access, NO_NODE for simple variables
+};
 
-public:
-    ConstNode(string val, string type) : ExprNode(type), value(val) {}
+struct ConstNode {
+    str_id value;
+};
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for constant values
-        string temp = "t" + to_string(temp_count++);
-        outcode << temp << " = " << value << endl;
-        return temp;
-    }
+struct BinaryOpNode {
+    str_id op;
+    node_id left, right;
 };
 
-// Binary operation node
+struct UnaryOpNode {
+    str_id op;
+    node_id expr;
+};
 
-class BinaryOpNode : public ExprNode {
-private:
-    string op;
-    ExprNode *left;
-    ExprNode *right;
+struct AssignNode {
+    node_id lhs; // always a VAR node
+    node_id rhs;
+};
 
-public:
-    BinaryOpNode(string op, ExprNode *left, ExprNode *right, string result_type)
-        : ExprNode(result_type), op(op), left(left), right(right) {}
+struct FuncCallNode {
+    str_id func_name;
+    uint32_t first_arg, num_args; // range in ASTArena::call_args
+};
 
-    ~BinaryOpNode() {
-        delete left;
-        delete right;
-    }
+struct ExprStmtNode {
+    node_id expr;
+};
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for binary operations
-        string lt = left ? left->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        string rt = right ? right->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        string temp = "t" + to_string(temp_count++);
-        outcode << temp << " = " << lt << " " << op << " " << rt << endl;
-        return temp;
-    }
+struct BlockNode {
+    NodeList statements;
 };
 
-// Unary operation node
+struct IfNode {
+    node_id condition, then_block, else_block; // else_block is NO_NODE if there is no else part
+};
 
-class UnaryOpNode : public ExprNode {
-private:
-    string op;
-    ExprNode *expr;
+struct WhileNode {
+    node_id condition, body;
+};
 
-public:
-    UnaryOpNode(string op, ExprNode *expr, string result_type)
-        : ExprNode(result_type), op(op), expr(expr) {}
-
-    ~UnaryOpNode() { delete expr; }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for unary operations
-        string et = expr ? expr->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        string temp = "t" + to_string(temp_count++);
-        if (op == "!" || op == "-" || op == "+") {
-            outcode << temp << " = " << op << et << endl;
-        } else {
-            outcode << temp << " = " << op << " " << et << endl;
-        }
-        return temp;
-    }
+struct ForNode {
+    node_id init, condition, update, body;
 };
 
-// Assignment node
+struct ReturnNode {
+    node_id expr;
+};
 
-class AssignNode : public ExprNode {
-private:
-    VarNode *lhs;
-    ExprNode *rhs;
+struct DeclVar {
+    str_id name;
+    int32_t array_size; // 0 for regular vars
+};
 
-public:
-    AssignNode(VarNode *lhs, ExprNode *rhs, string result_type)
-        : ExprNode(result_type), lhs(lhs), rhs(rhs) {}
-
-    ~AssignNode() {
-        delete lhs;
-        delete rhs;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for assignment operations
-        string right_temp = rhs ? rhs->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        if (lhs->has_index()) {
-            string offset = lhs->generate_index_code(outcode, symbol_to_temp, temp_count, label_count);
-            outcode << lhs->get_name() << "[" << offset << "] = " << right_temp << endl;
-        } else {
-            outcode << lhs->get_name() << " = " << right_temp << endl;
-
-            if (symbol_to_temp.find(lhs->get_name()) != symbol_to_temp.end()) {
-                symbol_to_temp.erase(lhs->get_name());
-            }
-        }
-        return right_temp;
-    }
+struct DeclNode {
+    str_id type;
+    uint32_t first_var, num_vars; // range in ASTArena::decl_vars
 };
 
-// Statement node types
+struct Param {
+    str_id type, name;
+};
 
-class StmtNode : public ASTNode {
-public:
-    virtual string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                                 int &temp_count, int &label_count) const = 0;
+struct FuncDeclNode {
+    str_id return_type, name;
+    uint32_t first_param, num_params; // range in ASTArena::params
+    node_id body;
 };
 
-// Expression statement node
+struct ArgumentsNode {
+    NodeList args;
+};
 
-class ExprStmtNode : public StmtNode {
-private:
-    ExprNode *expr;
+struct ProgramNode {
+    NodeList units;
+};
 
-public:
-    ExprStmtNode(ExprNode *e) : expr(e) {}
-    ~ExprStmtNode() { if(expr) delete expr; }
+// Identity of a pure expression node for hash-consing: kind, type, the
+// name/value/operator and up to two children
+struct ConsKey {
+    NodeKind kind;
+    uint16_t type;
+    uint32_t a, b, c;
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for expression statements
-        if (expr) expr->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        return "";
+    bool operator==(const ConsKey &o) const {
+        return kind == o.kind && type == o.type && a == o.a && b == o.b && c == o.c;
     }
 };
 
-// Block (compound statement) node
+struct ConsKeyHash {
+    size_t operator()(const ConsKey &k) const {
+        uint64_t h = (uint64_t)k.kind << 16 | k.type;
+        for (uint32_t v : {k.a, k.b, k.c}) h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+        return h ^ (h >> 32);
+    }
+};
 
-class BlockNode : public StmtNode {
+class ASTArena {
 private:
-    vector<StmtNode *> statements;
-
-public:
-    ~BlockNode() {
-        for (auto stmt : statements) {
-            delete stmt;
+    vector<NodeHeader> nodes;
+
+    vector<VarNode> vars;
+    vector<ConstNode> consts;
+    vector<BinaryOpNode> binary_ops;
+    vector<UnaryOpNode> unary_ops;
+    vector<AssignNode> assigns;
+    vector<FuncCallNode> func_calls;
+    vector<ExprStmtNode> expr_stmts;
+    vector<BlockNode> blocks;
+    vector<IfNode> ifs;
+    vector<WhileNode> whiles;
+    vector<ForNode> fors;
+    vector<ReturnNode> returns;
+    vector<DeclNode> decls;
+    vector<FuncDeclNode> func_decls;
+    vector<ArgumentsNode> arguments;
+    vector<ProgramNode> programs;
+
+    vector<ListCell> cells;
+    vector<node_id> call_args;
+    vector<DeclVar> decl_vars;
+    vector<Param> params;
+
+    deque<string> strings; // deque so the views in string_ids stay valid
+    unordered_map<string_view, str_id> string_ids;
+    vector<string> types;
+
+    // Expression DAG (see set_hash_consing)
+    bool hash_consing = false;
+    unordered_map<ConsKey, node_id, ConsKeyHash> cons_table;
+    unordered_map<node_id, vector<str_id>> cons_reads;      // variables a shared node reads
+    unordered_map<str_id, vector<node_id>> cons_readers;    // shared nodes that read a variable
+
+    template <class T>
+    node_id add_node(NodeKind kind, vector<T> &payloads, T payload, string_view type = "") {
+        nodes.push_back({kind, 0, intern_type(type), (uint32_t)payloads.size()});
+        payloads.push_back(payload);
+        return nodes.size() - 1;
+    }
+
+    uint16_t intern_type(string_view type) {
+        for (size_t i = 0; i < types.size(); i++) {
+            if (types[i] == type) return i;
+        }
+        types.emplace_back(type);
+        return types.size() - 1;
+    }
+
+    void append(NodeList &list, node_id item) {
+        cells.push_back({item, 0});
+        uint32_t cell = cells.size() - 1;
+        if (list.count) cells[list.last].next = cell;
+        else list.first = cell;
+        list.last = cell;
+        list.count++;
+    }
+
+    // Builds a pure expression node, or returns the equal one already built in
+    // this region. a is the name/value/operator, b and c the children; a VAR
+    // node reads the variable a.
+    template <class T>
+    node_id make_pure(NodeKind kind, vector<T> &payloads, T payload, string_view type,
+                      uint32_t a, node_id b = NO_NODE, node_id c = NO_NODE) {
+        if (!hash_consing) return add_node(kind, payloads, payload, type);
+
+        ConsKey key = {kind, intern_type(type), a, b, c};
+        auto it = cons_table.find(key);
+        if (it != cons_table.end()) return it->second;
+
+        node_id id = add_node(kind, payloads, payload, type);
+        cons_table.emplace(key, id);
+
+        vector<str_id> reads;
+        if (kind == NodeKind::VAR) reads.push_back(a);
+        for (node_id child : {b, c}) {
+            auto r = cons_reads.find(child);
+            if (child && r != cons_reads.end()) reads.insert(reads.end(), r->second.begin(), r->second.end());
+        }
+        for (str_id v : reads) cons_readers[v].push_back(id);
+        if (!reads.empty()) cons_reads.emplace(id, std::move(reads));
+        return id;
+    }
+
+    ConsKey cons_key(node_id id) const {
+        const NodeHeader &h = nodes[id];
+        switch (h.kind) {
+        case NodeKind::VAR: return {h.kind, h.type, vars[h.slot].name, vars[h.slot].index, 0};
+        case NodeKind::CONST: return {h.kind, h.type, consts[h.slot].value, 0, 0};
+        case NodeKind::BINARY_OP: {
+            const BinaryOpNode &b = binary_ops[h.slot];
+            return {h.kind, h.type, b.op, b.left, b.right};
+        }
+        case NodeKind::UNARY_OP: return {h.kind, h.type, unary_ops[h.slot].op, unary_ops[h.slot].expr, 0};
+        default: return {h.kind, h.type, 0, 0, 0};
         }
     }
 
-    void add_statement(StmtNode* stmt) {
-        if (stmt) statements.push_back(stmt);
+    // Forgets the shared nodes that read var, after it is written or redeclared
+    void kill(str_id var) {
+        if (!hash_consing) return;
+        auto it = cons_readers.find(var);
+        if (it == cons_readers.end()) return;
+        for (node_id id : it->second) {
+            auto entry = cons_table.find(cons_key(id));
+            if (entry != cons_table.end() && entry->second == id) cons_table.erase(entry);
+        }
+        cons_readers.erase(it);
     }
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for all statements in the block
-        for (auto stmt : statements) {
-            if (stmt) stmt->generate_code(outcode, symbol_to_temp, temp_count, label_count);
+    const NodeHeader &header(node_id id, NodeKind kind) const {
+        const NodeHeader &h = nodes[id];
+        if (h.kind != kind) {
+            cerr << "AST node " << id << " is not of the requested kind" << endl;
+            abort();
         }
-        return "";
+        return h;
     }
-};
-
-// If statement node
-
-class IfNode : public StmtNode {
-private:
-    ExprNode *condition;
-    StmtNode *then_block;
-    StmtNode *else_block; // nullptr if no else part
 
 public:
-    IfNode(ExprNode *cond, StmtNode *then_stmt, StmtNode *else_stmt = nullptr)
-        : condition(cond), then_block(then_stmt), else_block(else_stmt) {}
-
-    ~IfNode() {
-        delete condition;
-        delete then_block;
-        if (else_block) delete else_block;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for if-else statements
-        string cond = condition ? condition->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        string Ltrue = "L" + to_string(label_count++);
-        string Lfalse = "L" + to_string(label_count++);
-        string Lend = "L" + to_string(label_count++);
-        outcode << "if " << cond << " goto " << Ltrue << endl;
-        outcode << "goto " << Lfalse << endl;
-        outcode << Ltrue << ":" << endl;
-        if (then_block) then_block->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        outcode << "goto " << Lend << endl;
-        outcode << Lfalse << ":" << endl;
-        if (else_block) else_block->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        outcode << Lend << ":" << endl;
-        return "";
+    ASTArena() {
+        nodes.push_back({NodeKind::NONE, 0, 0, 0});
+        cells.push_back({NO_NODE, 0});
+        types.emplace_back("");
     }
-};
 
-// While statement node
+    ASTArena(const ASTArena &) = delete;
+    ASTArena &operator=(const ASTArena &) = delete;
 
-class WhileNode : public StmtNode {
-private:
-    ExprNode *condition;
-    StmtNode *body;
+    // Drops every node and string; node and string ids start over. The
+    // hash-consing mode is kept.
+    void clear() {
+        nodes.assign(1, {NodeKind::NONE, 0, 0, 0});
 
-public:
-    WhileNode(ExprNode *cond, StmtNode *body_stmt)
-        : condition(cond), body(body_stmt) {}
-
-    ~WhileNode() {
-        delete condition;
-        delete body;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for while loops
-        string Lbegin = "L" + to_string(label_count++);
-        string Lbody = "L" + to_string(label_count++);
-        string Lend = "L" + to_string(label_count++);
-        outcode << Lbegin << ":" << endl;
-        string cond = condition ? condition->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        outcode << "if " << cond << " goto " << Lbody << endl;
-        outcode << "goto " << Lend << endl;
-        outcode << Lbody << ":" << endl;
-        if (body) body->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        outcode << "goto " << Lbegin << endl;
-        outcode << Lend << ":" << endl;
-        return "";
-    }
-};
+        vars.clear();
+        consts.clear();
+        binary_ops.clear();
+        unary_ops.clear();
+        assigns.clear();
+        func_calls.clear();
+        expr_stmts.clear();
+        blocks.clear();
+        ifs.clear();
+        whiles.clear();
+        fors.clear();
+        returns.clear();
+        decls.clear();
+        func_decls.clear();
+        arguments.clear();
+        programs.clear();
 
-// For statement node
+        cells.assign(1, {NO_NODE, 0});
+        call_args.clear();
+        decl_vars.clear();
+        params.clear();
 
-class ForNode : public StmtNode {
-private:
-    ExprNode *init;
-    ExprNode *condition;
-    ExprNode *update;
-    StmtNode *body;
+        string_ids.clear();
+        strings.clear();
+        types.assign(1, "");
 
-public:
-    ForNode(ExprNode *init_expr, ExprNode *cond_expr, ExprNode *update_expr, StmtNode *body_stmt)
-        : init(init_expr), condition(cond_expr), update(update_expr), body(body_stmt) {}
-
-    ~ForNode() {
-        if (init) delete init;
-        if (condition) delete condition;
-        if (update) delete update;
-        delete body;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for for loops
-        if (init) init->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        string Lbegin = "L" + to_string(label_count++);
-        string Lbody = "L" + to_string(label_count++);
-        string Lend = "L" + to_string(label_count++);
-        outcode << Lbegin << ":" << endl;
-        string cond = condition ? condition->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        outcode << "if " << cond << " goto " << Lbody << endl;
-        outcode << "goto " << Lend << endl;
-        outcode << Lbody << ":" << endl;
-        if (body) body->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        if (update) update->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        outcode << "goto " << Lbegin << endl;
-        outcode << Lend << ":" << endl;
-        return "";
+        begin_region();
     }
-};
 
-// Return statement node
+    str_id intern(string_view s) {
+        auto it = string_ids.find(s);
+        if (it != string_ids.end()) return it->second;
+        strings.emplace_back(s);
+        str_id id = strings.size() - 1;
+        string_ids.emplace(strings.back(), id);
+        return id;
+    }
 
-class ReturnNode : public StmtNode {
-private:
-    ExprNode *expr;
+    // Expression DAG mode. While on, VAR, CONST, BINARY_OP and UNARY_OP nodes
+    // with the same (kind, type, name/value/operator, children) are built once
+    // and shared, so a repeated subexpression is one node. Sharing only happens
+    // within a straight-line region: an assignment or declaration forgets the
+    // nodes reading that variable, a call forgets everything, and the parser
+    // calls begin_region() wherever control flow joins or loops back. Two uses
+    // of one node therefore always see the same value.
+    void set_hash_consing(bool on) {
+        hash_consing = on;
+        begin_region();
+    }
 
-public:
-    ReturnNode(ExprNode* e) : expr(e) {}
-    ~ReturnNode() { if (expr) delete expr; }
+    bool is_hash_consing() const { return hash_consing; }
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for return statements
-        string val = expr ? expr->generate_code(outcode, symbol_to_temp, temp_count, label_count) : "";
-        outcode << "return " << val << endl;
-        return val;
+    void begin_region() {
+        cons_table.clear();
+        cons_reads.clear();
+        cons_readers.clear();
     }
-};
 
-// Declaration node
+    // Node construction
 
-class DeclNode : public StmtNode {
-private:
-    string type;
-    vector<pair<string, int>> vars; // Variable name and array size (0 for regular vars)
+    node_id make_var(string_view name, string_view type, node_id index = NO_NODE) {
+        VarNode v = {intern(name), index};
+        return make_pure(NodeKind::VAR, vars, v, type, v.name, index);
+    }
 
-public:
-    DeclNode(string t) : type(t) {}
-    
-    void add_var(string name, int array_size = 0) {
-        vars.push_back(make_pair(name, array_size));
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for variable declarations
-        for (auto &var : vars) {
-            if (var.second > 0) {
-                outcode << "// Declaration: " << type << " " << var.first << "[" << var.second << "]" << endl;
-            } else {
-                outcode << "// Declaration: " << type << " " << var.first << endl;
-            }
-        }
-        return "";
+    node_id make_const(string_view value, string_view type) {
+        ConstNode c = {intern(value)};
+        return make_pure(NodeKind::CONST, consts, c, type, c.value);
     }
 
-    string get_type() const { return type; }
-    const vector<pair<string, int>> &get_vars() const { return vars; }
-};
+    node_id make_binary_op(string_view op, node_id left, node_id right, string_view result_type) {
+        BinaryOpNode b = {intern(op), left, right};
+        return make_pure(NodeKind::BINARY_OP, binary_ops, b, result_type, b.op, left, right);
+    }
 
-// Function declaration node
+    node_id make_unary_op(string_view op, node_id expr, string_view result_type) {
+        UnaryOpNode u = {intern(op), expr};
+        return make_pure(NodeKind::UNARY_OP, unary_ops, u, result_type, u.op, expr);
+    }
 
-class FuncDeclNode : public ASTNode {
-private:
-    string return_type;
-    string name;
-    vector<pair<string, string>> params; // Parameter type and name
-    BlockNode *body;
+    node_id make_assign(node_id lhs, node_id rhs, string_view result_type) {
+        node_id id = add_node(NodeKind::ASSIGN, assigns, AssignNode{lhs, rhs}, result_type);
+        if (lhs && kind(lhs) == NodeKind::VAR) kill(var(lhs).name);
+        return id;
+    }
 
-public:
-    FuncDeclNode(string ret_type, string n) : return_type(ret_type), name(n), body(nullptr) {}
-    ~FuncDeclNode() { if (body) delete body; }
-    
-    void add_param(string type, string name) {
-        params.push_back(make_pair(type, name));
-    }
-    
-    void set_body(BlockNode* b) {
-        body = b;
-    }
-
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for function declarations
-        outcode << "// Function: " << return_type << " " << name << "(";
-        for (size_t i = 0; i < params.size(); ++i) {
-            outcode << params[i].first << " " << params[i].second;
-            if (i + 1 < params.size()) outcode << ", ";
+    // Copies the arguments collected in an ARGUMENTS node (if any) next to each other
+    node_id make_func_call(string_view name, string_view result_type, node_id args = NO_NODE) {
+        FuncCallNode call = {intern(name), (uint32_t)call_args.size(), 0};
+        if (args && kind(args) == NodeKind::ARGUMENTS) {
+            for_each(arguments[nodes[args].slot].args, [&](node_id arg) { call_args.push_back(arg); });
+            call.num_args = call_args.size() - call.first_arg;
         }
-        outcode << ")" << endl;
-        if (body) body->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-        outcode << endl;
-        return "";
+        if (hash_consing) begin_region(); // the callee may write any global
+        return add_node(NodeKind::FUNC_CALL, func_calls, call, result_type);
     }
-};
-
-// Helper class for function arguments
-
-class ArgumentsNode : public ASTNode {
-private:
-    vector<ExprNode *> args;
 
-public:
-    ~ArgumentsNode() {
-        // Don't delete args here - they'll be transferred to FuncCallNode
+    node_id make_expr_stmt(node_id expr) {
+        return add_node(NodeKind::EXPR_STMT, expr_stmts, ExprStmtNode{expr});
     }
 
-    void add_argument(ExprNode* arg) {
-        if (arg) args.push_back(arg);
+    node_id make_block() {
+        return add_node(NodeKind::BLOCK, blocks, BlockNode{});
     }
 
-    ExprNode* get_argument(int index) const {
-        if (index >= 0 && index < args.size()) {
-            return args[index];
-        }
-        return nullptr;
+    node_id make_if(node_id cond, node_id then_stmt, node_id else_stmt = NO_NODE) {
+        return add_node(NodeKind::IF, ifs, IfNode{cond, then_stmt, else_stmt});
     }
-    
-    size_t size() const {
-        return args.size();
+
+    node_id make_while(node_id cond, node_id body) {
+        return add_node(NodeKind::WHILE, whiles, WhileNode{cond, body});
     }
-    
-    const vector<ExprNode*>& get_arguments() const {
-        return args;
+
+    node_id make_for(node_id init, node_id cond, node_id update, node_id body) {
+        return add_node(NodeKind::FOR, fors, ForNode{init, cond, update, body});
     }
 
-    string generate_code(ofstream &outcode, map<string, string> &symbol_to_temp,
-                         int &temp_count, int &label_count) const override
-    {
-        // This node doesn't generate code directly
-        return "";
+    node_id make_return(node_id expr) {
+        return add_node(NodeKind::RETURN, returns, ReturnNode{expr});
     }
-};
 
-// Function call node
+    node_id make_decl(string_view type) {
+        return add_node(NodeKind::DECL, decls, DeclNode{intern(type), (uint32_t)decl_vars.size(), 0});
+    }
 
-class FuncCallNode : public ExprNode {
-private:
-    string func_name;
-    vector<ExprNode *> arguments;
+    node_id make_func_decl(string_view ret_type, string_view name) {
+        return add_node(NodeKind::FUNC_DECL, func_decls, FuncDeclNode{intern(ret_type), intern(name), (uint32_t)params.size(), 0, NO_NODE});
+    }
 
-public:
-    FuncCallNode(string name, string result_type)
-        : ExprNode(result_type), func_name(name) {}
-    
-    ~FuncCallNode() {
-        for (auto arg : arguments) {
-            delete arg;
-        }
+    node_id make_arguments() {
+        return add_node(NodeKind::ARGUMENTS, arguments, ArgumentsNode{});
     }
-    
-    void add_argument(ExprNode* arg) {
-        if (arg) arguments.push_back(arg);
-    }
-    
-    string generate_code(ofstream& outcode, map<string, string>& symbol_to_temp,
-                        int& temp_count, int& label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for function calls
-        vector<string> temps;
-        for (auto arg : arguments) {
-            if (arg) {
-                string t = arg->generate_code(outcode, symbol_to_temp, temp_count, label_count);
-                temps.push_back(t);
-            }
-        }
-        for (auto &t : temps) {
-            outcode << "param " << t << endl;
-        }
-        string ret = "t" + to_string(temp_count++);
-        outcode << ret << " = call " << func_name << ", " << temps.size() << endl;
-        return ret;
+
+    node_id make_program() {
+        return add_node(NodeKind::PROGRAM, programs, ProgramNode{});
     }
-};
 
-// Program node (root of AST)
+    // Incremental construction. Variables and parameters are stored as a range,
+    // so they must be added before the next declaration or function is made.
 
-class ProgramNode : public ASTNode{
-private:
-    vector<ASTNode *> units;
+    void add_statement(node_id block, node_id stmt) {
+        if (stmt) append(blocks[header(block, NodeKind::BLOCK).slot].statements, stmt);
+    }
 
-public:
-    ~ProgramNode() {
-        for (auto unit : units) {
-            delete unit;
+    void add_var(node_id decl, string_view name, int array_size = 0) {
+        DeclNode &d = decls[header(decl, NodeKind::DECL).slot];
+        if (d.first_var + d.num_vars != decl_vars.size()) {
+            cerr << "AST declaration " << decl << " is no longer the last one" << endl;
+            abort();
         }
+        decl_vars.push_back({intern(name), array_size});
+        d.num_vars++;
+        kill(decl_vars.back().name);
     }
-    
-    void add_unit(ASTNode* unit) {
-        if (unit) units.push_back(unit);
-    }
-    
-    string generate_code(ofstream& outcode, map<string, string>& symbol_to_temp,
-                        int& temp_count, int& label_count) const override {
-        // TODO: Implement this method
-        // Should generate code for the entire program
-        for (auto unit : units) {
-            if (unit) unit->generate_code(outcode, symbol_to_temp, temp_count, label_count);
+
+    void add_param(node_id func, string_view type, string_view name) {
+        FuncDeclNode &f = func_decls[header(func, NodeKind::FUNC_DECL).slot];
+        if (f.first_param + f.num_params != params.size()) {
+            cerr << "AST function " << func << " is no longer the last one" << endl;
+            abort();
+        }
+        params.push_back({intern(type), intern(name)});
+        f.num_params++;
+    }
+
+    void set_body(node_id func, node_id body) {
+        func_decls[header(func, NodeKind::FUNC_DECL).slot].body = body;
+    }
+
+    void add_argument(node_id args, node_id arg) {
+        if (arg) append(arguments[header(args, NodeKind::ARGUMENTS).slot].args, arg);
+    }
+
+    void add_unit(node_id program, node_id unit) {
+        if (unit) append(programs[header(program, NodeKind::PROGRAM).slot].units, unit);
+    }
+
+    // Access
+
+    size_t size() const { return nodes.size() - 1; }
+    NodeKind kind(node_id id) const { return nodes[id].kind; }
+    const string &get_type(node_id id) const { return types[nodes[id].type]; }
+    uint16_t type_id(node_id id) const { return nodes[id].type; }
+    bool has_flag(node_id id, NodeFlag f) const { return nodes[id].flags & f; }
+    void set_flag(node_id id, NodeFlag f, bool on = true) {
+        nodes[id].flags = on ? (nodes[id].flags | f) : (nodes[id].flags & ~f);
+    }
+    const string &str(str_id id) const { return strings[id]; }
+
+    const VarNode &var(node_id id) const { return vars[header(id, NodeKind::VAR).slot]; }
+    const ConstNode &constant(node_id id) const { return consts[header(id, NodeKind::CONST).slot]; }
+    const BinaryOpNode &binary_op(node_id id) const { return binary_ops[header(id, NodeKind::BINARY_OP).slot]; }
+    const UnaryOpNode &unary_op(node_id id) const { return unary_ops[header(id, NodeKind::UNARY_OP).slot]; }
+    const AssignNode &assign(node_id id) const { return assigns[header(id, NodeKind::ASSIGN).slot]; }
+    const FuncCallNode &func_call(node_id id) const { return func_calls[header(id, NodeKind::FUNC_CALL).slot]; }
+    const ExprStmtNode &expr_stmt(node_id id) const { return expr_stmts[header(id, NodeKind::EXPR_STMT).slot]; }
+    const BlockNode &block(node_id id) const { return blocks[header(id, NodeKind::BLOCK).slot]; }
+    const IfNode &if_stmt(node_id id) const { return ifs[header(id, NodeKind::IF).slot]; }
+    const WhileNode &while_stmt(node_id id) const { return whiles[header(id, NodeKind::WHILE).slot]; }
+    const ForNode &for_stmt(node_id id) const { return fors[header(id, NodeKind::FOR).slot]; }
+    const ReturnNode &return_stmt(node_id id) const { return returns[header(id, NodeKind::RETURN).slot]; }
+    const DeclNode &decl(node_id id) const { return decls[header(id, NodeKind::DECL).slot]; }
+    const FuncDeclNode &func_decl(node_id id) const { return func_decls[header(id, NodeKind::FUNC_DECL).slot]; }
+    const ProgramNode &program(node_id id) const { return programs[header(id, NodeKind::PROGRAM).slot]; }
+
+    // Mutable payloads for passes that rewrite children in place. Building new
+    // nodes of the same kind invalidates these references.
+    VarNode &var(node_id id) { return vars[header(id, NodeKind::VAR).slot]; }
+    BinaryOpNode &binary_op(node_id id) { return binary_ops[header(id, NodeKind::BINARY_OP).slot]; }
+    UnaryOpNode &unary_op(node_id id) { return unary_ops[header(id, NodeKind::UNARY_OP).slot]; }
+    AssignNode &assign(node_id id) { return assigns[header(id, NodeKind::ASSIGN).slot]; }
+    ExprStmtNode &expr_stmt(node_id id) { return expr_stmts[header(id, NodeKind::EXPR_STMT).slot]; }
+    IfNode &if_stmt(node_id id) { return ifs[header(id, NodeKind::IF).slot]; }
+    WhileNode &while_stmt(node_id id) { return whiles[header(id, NodeKind::WHILE).slot]; }
+    ForNode &for_stmt(node_id id) { return fors[header(id, NodeKind::FOR).slot]; }
+    ReturnNode &return_stmt(node_id id) { return returns[header(id, NodeKind::RETURN).slot]; }
+
+    node_id call_arg(const FuncCallNode &call, uint32_t i) const { return call_args[call.first_arg + i]; }
+    void set_call_arg(const FuncCallNode &call, uint32_t i, node_id arg) { call_args[call.first_arg + i] = arg; }
+    const DeclVar &decl_var(const DeclNode &d, uint32_t i) const { return decl_vars[d.first_var + i]; }
+    const Param &param(const FuncDeclNode &f, uint32_t i) const { return params[f.first_param + i]; }
+
+    template <class F>
+    void for_each(const NodeList &list, F f) const {
+        for (uint32_t c = list.first; c; c = cells[c].next) f(cells[c].item);
+    }
+
+    // Calls f(child) for every non-empty child of id, in evaluation order
+    template <class F>
+    void for_each_child(node_id id, F f) const {
+        auto visit = [&](node_id c) { if (c) f(c); };
+        switch (kind(id)) {
+        case NodeKind::VAR: visit(var(id).index); break;
+        case NodeKind::BINARY_OP: visit(binary_op(id).left); visit(binary_op(id).right); break;
+        case NodeKind::UNARY_OP: visit(unary_op(id).expr); break;
+        case NodeKind::ASSIGN: visit(assign(id).lhs); visit(assign(id).rhs); break;
+        case NodeKind::FUNC_CALL: {
+            const FuncCallNode &call = func_call(id);
+            for (uint32_t i = 0; i < call.num_args; i++) visit(call_arg(call, i));
+            break;
+        }
+        case NodeKind::EXPR_STMT: visit(expr_stmt(id).expr); break;
+        case NodeKind::BLOCK: for_each(block(id).statements, visit); break;
+        case NodeKind::IF: {
+            const IfNode &s = if_stmt(id);
+            visit(s.condition); visit(s.then_block); visit(s.else_block);
+            break;
+        }
+        case NodeKind::WHILE: visit(while_stmt(id).condition); visit(while_stmt(id).body); break;
+        case NodeKind::FOR: {
+            const ForNode &s = for_stmt(id);
+            visit(s.init); visit(s.condition); visit(s.update); visit(s.body);
+            break;
+        }
+        case NodeKind::RETURN: visit(return_stmt(id).expr); break;
+        case NodeKind::FUNC_DECL: visit(func_decl(id).body); break;
+        case NodeKind::ARGUMENTS: for_each(arguments[nodes[id].slot].args, visit); break;
+        case NodeKind::PROGRAM: for_each(program(id).units, visit); break;
+        default: break;
         }
-        return "";
     }
 };
 
-#endif // AST_H
\ No newline at end of file
+#endif // AST_H
@@ -0,0 +1,140 @@
+#ifndef AST_VERIFIER_H
+#define AST_VERIFIER_H
+
+#include "ast_visitor.h"
+#include "pass_manager.h"
+
+using namespace std;
+
+// Checks the shape invariants later passes rely on: expression slots hold
+// expressions, statement slots hold statements, an assignment target is a
+// variable and a program holds only declarations and functions. The for-loop
+// init and condition slots hold expression statements, as the grammar builds them.
+
+class ASTVerifier : public ASTVisitor<> {
+private:
+    string problem;
+
+    void expect(bool ok, node_id id, const char *what) {
+        if (!ok && problem.empty()) problem = "node " + to_string(id) + ": " + what;
+    }
+
+    void expect_expr(node_id parent, node_id child, const char *what) {
+        if (child) expect(is_expr(ast.kind(child)), parent, what);
+    }
+
+    void expect_stmt(node_id parent, node_id child, const char *what) {
+        if (child) expect(is_stmt(ast.kind(child)), parent, what);
+    }
+
+public:
+    ASTVerifier(const ASTArena &ast) : ASTVisitor(ast) {}
+
+    // Returns an empty string if the tree at root is well formed
+    string verify(node_id root) {
+        problem.clear();
+        visit(root);
+        return problem;
+    }
+
+    void visit_var(node_id id) override {
+        expect_expr(id, ast.var(id).index, "array index is not an expression");
+        visit_children(id);
+    }
+
+    void visit_binary_op(node_id id) override {
+        const BinaryOpNode &b = ast.binary_op(id);
+        expect(b.left && b.right, id, "binary operator is missing an operand");
+        expect_expr(id, b.left, "left operand is not an expression");
+        expect_expr(id, b.right, "right operand is not an expression");
+        visit_children(id);
+    }
+
+    void visit_unary_op(node_id id) override {
+        expect(ast.unary_op(id).expr, id, "unary operator is missing its operand");
+        expect_expr(id, ast.unary_op(id).expr, "operand is not an expression");
+        visit_children(id);
+    }
+
+    void visit_assign(node_id id) override {
+        const AssignNode &a = ast.assign(id);
+        expect(a.lhs && ast.kind(a.lhs) == NodeKind::VAR, id, "assignment target is not a variable");
+        expect_expr(id, a.rhs, "assigned value is not an expression");
+        visit_children(id);
+    }
+
+    void visit_func_call(node_id id) override {
+        const FuncCallNode &call = ast.func_call(id);
+        for (uint32_t i = 0; i < call.num_args; i++) {
+            expect_expr(id, ast.call_arg(call, i), "call argument is not an expression");
+        }
+        visit_children(id);
+    }
+
+    void visit_block(node_id id) override {
+        ast.for_each(ast.block(id).statements, [&](node_id stmt) {
+            expect_stmt(id, stmt, "block holds a non-statement");
+        });
+        visit_children(id);
+    }
+
+    void visit_if(node_id id) override {
+        const IfNode &s = ast.if_stmt(id);
+        expect_expr(id, s.condition, "if condition is not an expression");
+        expect_stmt(id, s.then_block, "if branch is not a statement");
+        expect_stmt(id, s.else_block, "else branch is not a statement");
+        visit_children(id);
+    }
+
+    void visit_while(node_id id) override {
+        const WhileNode &s = ast.while_stmt(id);
+        expect_expr(id, s.condition, "while condition is not an expression");
+        expect_stmt(id, s.body, "while body is not a statement");
+        visit_children(id);
+    }
+
+    void visit_for(node_id id) override {
+        const ForNode &s = ast.for_stmt(id);
+        expect(!s.init || ast.kind(s.init) == NodeKind::EXPR_STMT, id, "for init is not an expression statement");
+        expect(!s.condition || ast.kind(s.condition) == NodeKind::EXPR_STMT, id, "for condition is not an expression statement");
+        expect_expr(id, s.update, "for update is not an expression");
+        expect_stmt(id, s.body, "for body is not a statement");
+        visit_children(id);
+    }
+
+    void visit_return(node_id id) override {
+        expect_expr(id, ast.return_stmt(id).expr, "return value is not an expression");
+        visit_children(id);
+    }
+
+    void visit_func_decl(node_id id) override {
+        node_id body = ast.func_decl(id).body;
+        expect(!body || ast.kind(body) == NodeKind::BLOCK, id, "function body is not a block");
+        visit_children(id);
+    }
+
+    void visit_program(node_id id) override {
+        ast.for_each(ast.program(id).units, [&](node_id unit) {
+            NodeKind k = ast.kind(unit);
+            expect(k == NodeKind::FUNC_DECL || k == NodeKind::DECL, id, "program unit is not a declaration or function");
+        });
+        visit_children(id);
+    }
+};
+
+class ASTVerifierPass : public Pass {
+public:
+    string name() const override { return "verify-ast"; }
+
+    bool run(PassContext &ctx) override {
+        string problem = ASTVerifier(ctx.ast).verify(ctx.root);
+        if (!problem.empty()) {
+            ctx.outlog << "AST verification failed at " << problem << endl;
+            cerr << "AST verification failed at " << problem << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // AST_VERIFIER_H
@@ -0,0 +1,70 @@
+#ifndef AST_VISITOR_H
+#define AST_VISITOR_H
+
+#include "ast.h"
+
+using namespace std;
+
+// Visitor over the flat AST.
+//
+// visit(id) dispatches on the node kind to one hook per kind. Every hook
+// defaults to visiting the children in evaluation order and returning R(), so
+// a pass only overrides the kinds it cares about. Passes that need to return
+// something per node (a temp name, a constant value, ...) pick R; the rest use
+// void. Passes that rewrite the tree visit a non-const ASTArena.
+
+template <class R = void, class Arena = const ASTArena>
+class ASTVisitor {
+protected:
+    Arena &ast;
+
+    R visit_children(node_id id) {
+        ast.for_each_child(id, [&](node_id child) { visit(child); });
+        return R();
+    }
+
+public:
+    ASTVisitor(Arena &ast) : ast(ast) {}
+    virtual ~ASTVisitor() {}
+
+    R visit(node_id id) {
+        switch (ast.kind(id)) {
+        case NodeKind::VAR: return visit_var(id);
+        case NodeKind::CONST: return visit_const(id);
+        case NodeKind::BINARY_OP: return visit_binary_op(id);
+        case NodeKind::UNARY_OP: return visit_unary_op(id);
+        case NodeKind::ASSIGN: return visit_assign(id);
+        case NodeKind::FUNC_CALL: return visit_func_call(id);
+        case NodeKind::EXPR_STMT: return visit_expr_stmt(id);
+        case NodeKind::BLOCK: return visit_block(id);
+        case NodeKind::IF: return visit_if(id);
+        case NodeKind::WHILE: return visit_while(id);
+        case NodeKind::FOR: return visit_for(id);
+        case NodeKind::RETURN: return visit_return(id);
+        case NodeKind::DECL: return visit_decl(id);
+        case NodeKind::FUNC_DECL: return visit_func_decl(id);
+        case NodeKind::ARGUMENTS: return visit_arguments(id);
+        case NodeKind::PROGRAM: return visit_program(id);
+        default: return R(); // NO_NODE
+        }
+    }
+
+    virtual R visit_var(node_id id) { return visit_children(id); }
+    virtual R visit_const(node_id id) { return visit_children(id); }
+    virtual R visit_binary_op(node_id id) { return visit_children(id); }
+    virtual R visit_unary_op(node_id id) { return visit_children(id); }
+    virtual R visit_assign(node_id id) { return visit_children(id); }
+    virtual R visit_func_call(node_id id) { return visit_children(id); }
+    virtual R visit_expr_stmt(node_id id) { return visit_children(id); }
+    virtual R visit_block(node_id id) { return visit_children(id); }
+    virtual R visit_if(node_id id) { return visit_children(id); }
+    virtual R visit_while(node_id id) { return visit_children(id); }
+    virtual R visit_for(node_id id) { return visit_children(id); }
+    virtual R visit_return(node_id id) { return visit_children(id); }
+    virtual R visit_decl(node_id id) { return visit_children(id); }
+    virtual R visit_func_decl(node_id id) { return visit_children(id); }
+    virtual R visit_arguments(node_id id) { return visit_children(id); }
+    virtual R visit_program(node_id id) { return visit_children(id); }
+};
+
+#endif // AST_VISITOR_H
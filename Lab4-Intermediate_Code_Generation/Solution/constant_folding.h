@@ -0,0 +1,423 @@
+#ifndef CONSTANT_FOLDING_H
+#define CONSTANT_FOLDING_H
+
+#include "ast_visitor.h"
+#include "pass_manager.h"
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+
+using namespace std;
+
+// Constant folding and propagation over the AST (-O1).
+//
+// Expressions whose operands are constants are replaced by a CONST node, with
+// C semantics for int (32-bit, truncating division) and float (single
+// precision) arithmetic, relational and logical operators and unary -, + and !.
+// Anything that would be undefined or not representable (overflow, division or
+// modulus by zero, a non-finite float) is left alone; division and modulus by a
+// constant zero are reported as warnings.
+//
+// Variables assigned a constant are propagated into later reads along
+// straight-line code. Knowledge is dropped when a variable is redeclared or
+// goes out of scope, when a call may write it (any global), at the head of a
+// loop that writes it, and where the branches of an if disagree.
+//
+// Children are rewritten by replacing the parent's reference, never the child
+// node itself, so a node shared by the expression DAG or used as an assignment
+// target is never changed under another user.
+
+struct ConstValue {
+    bool is_float;
+    long long i; // when !is_float
+    float f;     // when is_float
+
+    float as_float() const { return is_float ? f : (float)i; }
+    bool truthy() const { return is_float ? f != 0.0f : i != 0; }
+    bool operator==(const ConstValue &o) const {
+        return is_float == o.is_float && (is_float ? f == o.f : i == o.i);
+    }
+};
+
+class ConstantFolder : public ASTVisitor<node_id, ASTArena> {
+private:
+    ofstream &outlog;
+    ofstream &outerror;
+
+    map<str_id, ConstValue> env;        // variables known to hold a constant here
+    map<str_id, int> local_depth;       // how many enclosing declarations of a name are locals
+    vector<vector<str_id>> scope_decls; // names declared in each open block
+    set<node_id> diagnosed;
+    string func_name;
+
+public:
+    int folded = 0;
+    int propagated = 0;
+
+private:
+    static ConstValue int_value(long long v) { return {false, v, 0.0f}; }
+    static ConstValue float_value(float v) { return {true, 0, v}; }
+    static bool fits_int(long long v) { return v >= INT_MIN && v <= INT_MAX; }
+
+    bool value_of(node_id id, ConstValue &out) const {
+        if (!id || ast.kind(id) != NodeKind::CONST) return false;
+        const string &text = ast.str(ast.constant(id).value);
+        const char *s = text.c_str();
+        char *end;
+        errno = 0;
+        if (ast.get_type(id) == "int") {
+            long long v = strtoll(s, &end, 10);
+            if (errno || *end || !fits_int(v)) return false;
+            out = int_value(v);
+            return true;
+        }
+        if (ast.get_type(id) == "float") {
+            float v = strtof(s, &end);
+            if (errno || *end || !isfinite(v)) return false;
+            out = float_value(v);
+            return true;
+        }
+        return false;
+    }
+
+    node_id make_const(const ConstValue &v) {
+        if (!v.is_float) return ast.make_const(to_string(v.i), "int");
+        // shortest text that reads back as the same float
+        char buf[32];
+        for (int precision = 6; precision <= 9; precision++) {
+            snprintf(buf, sizeof(buf), "%.*g", precision, (double)v.f);
+            if (strtof(buf, nullptr) == v.f) break;
+        }
+        string text = buf;
+        if (text.find_first_of(".e") == string::npos) text += ".0";
+        return ast.make_const(text, "float");
+    }
+
+    // Converts v to the declared type of a variable, as assignment does
+    static bool convert(const ConstValue &v, const string &type, ConstValue &out) {
+        if (type == "int") {
+            if (!v.is_float) out = v;
+            else if (v.f > (float)INT_MIN - 1.0f && v.f < (float)INT_MAX + 1.0f) out = int_value((long long)v.f);
+            else return false;
+            return true;
+        }
+        if (type == "float") {
+            out = float_value(v.as_float());
+            return true;
+        }
+        return false;
+    }
+
+    bool eval_binary(const string &op, const ConstValue &a, const ConstValue &b, ConstValue &out, bool &div_zero) const {
+        div_zero = false;
+        if (op == "&&") { out = int_value(a.truthy() && b.truthy()); return true; }
+        if (op == "||") { out = int_value(a.truthy() || b.truthy()); return true; }
+
+        if (a.is_float || b.is_float) {
+            float x = a.as_float(), y = b.as_float();
+            if (op == "<") out = int_value(x < y);
+            else if (op == "<=") out = int_value(x <= y);
+            else if (op == ">") out = int_value(x > y);
+            else if (op == ">=") out = int_value(x >= y);
+            else if (op == "==") out = int_value(x == y);
+            else if (op == "!=") out = int_value(x != y);
+            else {
+                float r;
+                if (op == "+") r = x + y;
+                else if (op == "-") r = x - y;
+                else if (op == "*") r = x * y;
+                else if (op == "/") {
+                    if (y == 0.0f) { div_zero = true; return false; }
+                    r = x / y;
+                }
+                else return false; // % is not defined on floats
+                if (!isfinite(r)) return false;
+                out = float_value(r);
+            }
+            return true;
+        }
+
+        long long x = a.i, y = b.i, r;
+        if (op == "<") r = x < y;
+        else if (op == "<=") r = x <= y;
+        else if (op == ">") r = x > y;
+        else if (op == ">=") r = x >= y;
+        else if (op == "==") r = x == y;
+        else if (op == "!=") r = x != y;
+        else if (op == "+") r = x + y;
+        else if (op == "-") r = x - y;
+        else if (op == "*") r = x * y;
+        else if (op == "/" || op == "%") {
+            if (y == 0) { div_zero = true; return false; }
+            if (x == INT_MIN && y == -1) return false;
+            r = op == "/" ? x / y : x % y;
+        }
+        else return false;
+        if (!fits_int(r)) return false;
+        out = int_value(r);
+        return true;
+    }
+
+    static bool eval_unary(const string &op, const ConstValue &a, ConstValue &out) {
+        if (op == "!") out = int_value(!a.truthy());
+        else if (op == "+") out = a;
+        else if (op == "-") {
+            if (a.is_float) out = float_value(-a.f);
+            else if (a.i == INT_MIN) return false;
+            else out = int_value(-a.i);
+        }
+        else return false;
+        return true;
+    }
+
+    // true if evaluating id has no side effects
+    bool is_pure(node_id id) const {
+        if (!id) return true;
+        NodeKind k = ast.kind(id);
+        if (k == NodeKind::ASSIGN || k == NodeKind::FUNC_CALL) return false;
+        bool pure = true;
+        ast.for_each_child(id, [&](node_id child) { pure = pure && is_pure(child); });
+        return pure;
+    }
+
+    // Variables assigned anywhere under id, and whether it contains a call
+    void collect_writes(node_id id, set<str_id> &writes, bool &calls) const {
+        if (!id) return;
+        if (ast.kind(id) == NodeKind::ASSIGN) writes.insert(ast.var(ast.assign(id).lhs).name);
+        if (ast.kind(id) == NodeKind::FUNC_CALL) calls = true;
+        ast.for_each_child(id, [&](node_id child) { collect_writes(child, writes, calls); });
+    }
+
+    void forget_globals() {
+        for (auto it = env.begin(); it != env.end();) {
+            auto local = local_depth.find(it->first);
+            if (local == local_depth.end() || local->second == 0) it = env.erase(it);
+            else ++it;
+        }
+    }
+
+    // Forgets what a loop may change before its first test
+    void enter_loop(initializer_list<node_id> parts) {
+        set<str_id> writes;
+        bool calls = false;
+        for (node_id part : parts) collect_writes(part, writes, calls);
+        for (str_id name : writes) env.erase(name);
+        if (calls) forget_globals();
+    }
+
+    // Keeps only what holds on both incoming paths
+    void meet(const map<str_id, ConstValue> &other) {
+        for (auto it = env.begin(); it != env.end();) {
+            auto o = other.find(it->first);
+            if (o == other.end() || !(o->second == it->second)) it = env.erase(it);
+            else ++it;
+        }
+    }
+
+    void diagnose_div_zero(node_id id, const string &op) {
+        if (!diagnosed.insert(id).second) return;
+        string what = op == "%" ? "modulus" : "division";
+        outerror << "Warning: " << what << " by constant zero in function " << func_name << " left unfolded" << endl << endl;
+        outlog << "Warning: " << what << " by constant zero in function " << func_name << " left unfolded" << endl << endl;
+    }
+
+public:
+    ConstantFolder(ASTArena &ast, ofstream &outlog, ofstream &outerror)
+        : ASTVisitor(ast), outlog(outlog), outerror(outerror), scope_decls(1) {}
+
+    // Expressions return the node that replaces them
+
+    node_id visit_var(node_id id) override {
+        node_id index = ast.var(id).index;
+        if (index) {
+            node_id folded_index = visit(index);
+            ast.var(id).index = folded_index;
+            return id;
+        }
+        auto it = env.find(ast.var(id).name);
+        if (it == env.end()) return id;
+        propagated++;
+        return make_const(it->second);
+    }
+
+    node_id visit_const(node_id id) override { return id; }
+
+    node_id visit_binary_op(node_id id) override {
+        string op = ast.str(ast.binary_op(id).op);
+        node_id left = visit(ast.binary_op(id).left);
+        node_id right;
+        if (op == "&&" || op == "||") {
+            // the right operand only runs for some values of the left one
+            map<str_id, ConstValue> skipped = env;
+            right = visit(ast.binary_op(id).right);
+            meet(skipped);
+        }
+        else right = visit(ast.binary_op(id).right);
+        ast.binary_op(id).left = left;
+        ast.binary_op(id).right = right;
+
+        ConstValue a, b, r;
+        bool lc = value_of(left, a), rc = value_of(right, b), div_zero;
+        if (lc && rc) {
+            if (eval_binary(op, a, b, r, div_zero)) {
+                folded++;
+                return make_const(r);
+            }
+            if (div_zero) diagnose_div_zero(id, op);
+            return id;
+        }
+        // 0 && e, e && 0, 1 || e and e || 1 need not know e, if e has no side effects
+        if ((lc && is_pure(right)) || (rc && is_pure(left))) {
+            const ConstValue &known = lc ? a : b;
+            if ((op == "&&" && !known.truthy()) || (op == "||" && known.truthy())) {
+                folded++;
+                return make_const(int_value(op == "||"));
+            }
+        }
+        return id;
+    }
+
+    node_id visit_unary_op(node_id id) override {
+        node_id expr = visit(ast.unary_op(id).expr);
+        ast.unary_op(id).expr = expr;
+        ConstValue a, r;
+        if (value_of(expr, a) && eval_unary(ast.str(ast.unary_op(id).op), a, r)) {
+            folded++;
+            return make_const(r);
+        }
+        return id;
+    }
+
+    node_id visit_assign(node_id id) override {
+        node_id rhs = visit(ast.assign(id).rhs);
+        ast.assign(id).rhs = rhs;
+
+        node_id lhs = ast.assign(id).lhs;
+        if (ast.var(lhs).index) {
+            node_id index = visit(ast.var(lhs).index);
+            ast.var(lhs).index = index;
+            return id;
+        }
+        str_id name = ast.var(lhs).name;
+        ConstValue v, stored;
+        if (value_of(rhs, v) && convert(v, ast.get_type(lhs), stored)) env[name] = stored;
+        else env.erase(name);
+        return id;
+    }
+
+    node_id visit_func_call(node_id id) override {
+        const FuncCallNode &call = ast.func_call(id);
+        for (uint32_t i = 0; i < call.num_args; i++) {
+            ast.set_call_arg(call, i, visit(ast.call_arg(call, i)));
+        }
+        forget_globals();
+        return id;
+    }
+
+    // Statements return themselves
+
+    node_id visit_expr_stmt(node_id id) override {
+        node_id expr = visit(ast.expr_stmt(id).expr);
+        ast.expr_stmt(id).expr = expr;
+        return id;
+    }
+
+    node_id visit_block(node_id id) override {
+        scope_decls.emplace_back();
+        visit_children(id);
+        for (str_id name : scope_decls.back()) {
+            env.erase(name);
+            local_depth[name]--;
+        }
+        scope_decls.pop_back();
+        return id;
+    }
+
+    node_id visit_decl(node_id id) override {
+        const DeclNode &d = ast.decl(id);
+        for (uint32_t i = 0; i < d.num_vars; i++) {
+            str_id name = ast.decl_var(d, i).name;
+            env.erase(name);
+            local_depth[name]++;
+            scope_decls.back().push_back(name);
+        }
+        return id;
+    }
+
+    node_id visit_if(node_id id) override {
+        node_id cond = visit(ast.if_stmt(id).condition);
+        ast.if_stmt(id).condition = cond;
+
+        map<str_id, ConstValue> before = env;
+        visit(ast.if_stmt(id).then_block);
+        map<str_id, ConstValue> after_then = std::move(env);
+        env = std::move(before);
+        visit(ast.if_stmt(id).else_block);
+        meet(after_then);
+        return id;
+    }
+
+    node_id visit_while(node_id id) override {
+        enter_loop({ast.while_stmt(id).condition, ast.while_stmt(id).body});
+        node_id cond = visit(ast.while_stmt(id).condition);
+        ast.while_stmt(id).condition = cond;
+
+        map<str_id, ConstValue> exit = env;
+        visit(ast.while_stmt(id).body);
+        env = std::move(exit);
+        return id;
+    }
+
+    node_id visit_for(node_id id) override {
+        visit(ast.for_stmt(id).init);
+        const ForNode &s = ast.for_stmt(id);
+        enter_loop({s.condition, s.update, s.body});
+        visit(ast.for_stmt(id).condition);
+
+        map<str_id, ConstValue> exit = env;
+        visit(ast.for_stmt(id).body);
+        node_id update = visit(ast.for_stmt(id).update);
+        ast.for_stmt(id).update = update;
+        env = std::move(exit);
+        return id;
+    }
+
+    node_id visit_return(node_id id) override {
+        node_id expr = visit(ast.return_stmt(id).expr);
+        ast.return_stmt(id).expr = expr;
+        return id;
+    }
+
+    node_id visit_func_decl(node_id id) override {
+        const FuncDeclNode &f = ast.func_decl(id);
+        func_name = ast.str(f.name);
+        env.clear();
+        local_depth.clear();
+        for (uint32_t i = 0; i < f.num_params; i++) local_depth[ast.param(f, i).name]++;
+        visit(f.body);
+        return id;
+    }
+};
+
+class ConstantFoldingPass : public Pass {
+public:
+    string name() const override { return "fold"; }
+    vector<string> dependencies() const override { return {"verify-ast"}; }
+    vector<string> run_before() const override { return {"sethi-ullman", "tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        ConstantFolder folder(ctx.ast, ctx.outlog, ctx.outerror);
+        folder.visit(ctx.root);
+        ctx.outlog << "Constant folding: " << folder.folded << " expressions folded, "
+                   << folder.propagated << " constant reads propagated" << endl;
+        return true;
+    }
+};
+
+#endif // CONSTANT_FOLDING_H
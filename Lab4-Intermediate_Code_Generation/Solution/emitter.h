@@ -0,0 +1,318 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Sinks for three-address code.
+//
+// The IR printer (print_tac in tac_ir.h) is a template over its emitter, so the
+// choice of output format is made at compile time and every instruction is a
+// direct, inlinable call. An emitter provides:
+//
+//   begin(), end()                       around the whole program
+//   comment(text)                        "// text"; blank() for an empty line
+//   copy(dst, src)                       dst = src      (dst a temp)
+//   load(dst, array, offset)             dst = array[offset]
+//   store(array, offset, src)            array[offset] = src
+//   assign(name, src)                    name = src
+//   binary(dst, a, op, b)                dst = a op b
+//   unary(dst, op, a)                    dst = op a
+//   param(a), call(dst, func, nargs)     dst = call func, nargs
+//   cond_jump(a, label)                  if a goto label
+//   branch(a, op, b, label)              if a op b goto label
+//   jump(label), label(label), ret(a)
+//
+// Labels are numbers and names are views into the IR string pool. Operands and
+// destinations are Values: the code generator only ever uses temps, except for
+// the name or constant a copy loads, but optimized code also names variables
+// and constants directly.
+
+// A temporary t<n>; the default value stands for "no value"
+struct Temp {
+    int32_t n = -1;
+    explicit operator bool() const { return n >= 0; }
+};
+
+// A temp, or a variable or constant by its text
+struct Value {
+    Temp temp;
+    string_view text;
+
+    Value() {}
+    Value(Temp t) : temp(t) {}
+    explicit Value(string_view s) : text(s) {}
+};
+
+enum class TacOp : uint8_t {
+    COPY, LOAD, STORE, ASSIGN, BINARY, UNARY, PARAM, CALL, COND_JUMP, JUMP, LABEL, RETURN, COMMENT, BRANCH,
+    COUNT
+};
+
+const char *const TAC_OP_NAMES[] = {
+    "copy", "load", "store", "assign", "binary", "unary", "param", "call", "cond_jump", "jump", "label", "return", "comment",
+    "branch"
+};
+
+// Human readable code, formatted with to_chars into a buffer that is written
+// out in large blocks
+class TextEmitter {
+private:
+    static const size_t CAPACITY = 1 << 16;
+
+    ostream &out;
+    char buf[CAPACITY];
+    size_t len = 0;
+
+    void flush() {
+        out.write(buf, len);
+        len = 0;
+    }
+
+    void put(string_view s) {
+        if (len + s.size() > CAPACITY) {
+            flush();
+            if (s.size() > CAPACITY) {
+                out.write(s.data(), s.size());
+                return;
+            }
+        }
+        memcpy(buf + len, s.data(), s.size());
+        len += s.size();
+    }
+
+    void put_number(char prefix, long long n) {
+        if (len + 24 > CAPACITY) flush();
+        if (prefix) buf[len++] = prefix;
+        len = to_chars(buf + len, buf + CAPACITY, n).ptr - buf;
+    }
+
+    // A missing operand prints as nothing, as the generator always has
+    void put(Temp t) {
+        if (t) put_number('t', t.n);
+    }
+
+    void put(Value v) {
+        if (v.temp) put(v.temp);
+        else put(v.text);
+    }
+
+    void put_label(int l) { put_number('L', l); }
+    void put(long long n) { put_number(0, n); }
+    void newline() { put("\n"); }
+
+public:
+    explicit TextEmitter(ostream &out) : out(out) {}
+    ~TextEmitter() { flush(); }
+
+    void begin() {
+        put("//========== THREE ADDRESS CODE ==========\n\n");
+        put("// This code was generated by a two-pass compiler\n");
+        put("// Format:\n");
+        put("// - t0, t1, etc. are temporary variables\n");
+        put("// - L0, L1, etc. are labels for jumps\n");
+        put("// - Operations follow the three-address code format\n\n");
+        put("// Three Address Code\n\n");
+    }
+
+    void end() {
+        put("\n//========== END OF CODE ==========\n");
+        flush();
+        out.flush();
+    }
+
+    void comment(string_view text) { put("// "); put(text); newline(); }
+    void blank() { newline(); }
+
+    void copy(Temp dst, Value src) { put(dst); put(" = "); put(src); newline(); }
+    void load(Value dst, string_view array, Value offset) {
+        put(dst); put(" = "); put(array); put("["); put(offset); put("]"); newline();
+    }
+    void store(string_view array, Value offset, Value src) {
+        put(array); put("["); put(offset); put("] = "); put(src); newline();
+    }
+    void assign(string_view name, Value src) { put(name); put(" = "); put(src); newline(); }
+    void binary(Value dst, Value a, string_view op, Value b) {
+        put(dst); put(" = "); put(a); put(" "); put(op); put(" "); put(b); newline();
+    }
+    void unary(Value dst, string_view op, Value a) {
+        put(dst); put(" = "); put(op);
+        if (op != "!" && op != "-" && op != "+") put(" ");
+        put(a); newline();
+    }
+    void param(Value a) { put("param "); put(a); newline(); }
+    void call(Value dst, string_view func, int nargs) {
+        put(dst); put(" = call "); put(func); put(", "); put((long long)nargs); newline();
+    }
+    void cond_jump(Value a, int l) { put("if "); put(a); put(" goto "); put_label(l); newline(); }
+    void branch(Value a, string_view op, Value b, int l) {
+        put("if "); put(a); put(" "); put(op); put(" "); put(b); put(" goto "); put_label(l); newline();
+    }
+    void jump(int l) { put("goto "); put_label(l); newline(); }
+    void label(int l) { put_label(l); put(":"); newline(); }
+    void ret(Value a) { put("return "); put(a); newline(); }
+};
+
+// Compact binary code. Layout (native byte order, recorded in the header so a
+// reader can tell which order the file was written in):
+//
+//   tac_header
+//   tac_record [num_records]
+//   char       [strtab_size]  names, operators and constants
+//
+// Temps are their numbers and -1 means none. Labels are their numbers. The
+// string of a record (str_off, str_len) is the source of a copy unless that is
+// a temp (then in a), the variable of a load, store or assign, the operator of
+// a binary, unary or branch, the function of a call (with the argument count
+// in b) and the text of a comment. The label of a jump is in dst. Any other
+// operand that is a name or constant is -2 - k for the string at strtab offset
+// k, which ends with a NUL.
+
+const char TAC_MAGIC[4] = {'T', 'A', 'C', 'B'};
+const uint16_t TAC_VERSION = 4;
+const uint16_t TAC_BYTE_ORDER = 0x0102;
+
+struct tac_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t num_records;
+    uint32_t strtab_size;
+};
+
+struct tac_record {
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t str_len;
+    uint32_t str_off;
+    int32_t dst;
+    int32_t a;
+    int32_t b;
+};
+
+static_assert(sizeof(tac_header) == 16, "TAC header layout changed");
+static_assert(sizeof(tac_record) == 20, "TAC record layout changed");
+
+class BinaryEmitter {
+private:
+    ostream &out;
+    vector<tac_record> records;
+    string strtab;
+    unordered_map<string, uint32_t> offsets, operands; // each distinct string is stored once
+
+    uint32_t offset(string_view s, unordered_map<string, uint32_t> &seen, bool terminate) {
+        auto it = seen.find(string(s));
+        if (it == seen.end()) {
+            it = seen.emplace(string(s), strtab.size()).first;
+            strtab.append(s);
+            if (terminate) strtab.push_back('\0');
+        }
+        return it->second;
+    }
+
+    int32_t operand(Value v) { return v.temp || v.text.empty() ? v.temp.n : -2 - (int32_t)offset(v.text, operands, true); }
+
+    void add(TacOp op, string_view s, int32_t dst, int32_t a, int32_t b) {
+        tac_record r = {};
+        r.op = (uint8_t)op;
+        if (!s.empty()) {
+            r.str_off = offset(s, offsets, false);
+            r.str_len = s.size();
+        }
+        r.dst = dst;
+        r.a = a;
+        r.b = b;
+        records.push_back(r);
+    }
+
+public:
+    explicit BinaryEmitter(ostream &out) : out(out) {}
+
+    void begin() {}
+
+    void end() {
+        tac_header h = {};
+        memcpy(h.magic, TAC_MAGIC, sizeof(h.magic));
+        h.version = TAC_VERSION;
+        h.byte_order = TAC_BYTE_ORDER;
+        h.num_records = records.size();
+        h.strtab_size = strtab.size();
+        out.write((const char *)&h, sizeof(h));
+        out.write((const char *)records.data(), records.size() * sizeof(tac_record));
+        out.write(strtab.data(), strtab.size());
+        out.flush();
+    }
+
+    void comment(string_view text) { add(TacOp::COMMENT, text, -1, -1, -1); }
+    void blank() {}
+
+    void copy(Temp dst, Value src) {
+        if (src.temp) add(TacOp::COPY, {}, dst.n, src.temp.n, -1);
+        else add(TacOp::COPY, src.text, dst.n, -1, -1);
+    }
+    void load(Value dst, string_view array, Value offset) { add(TacOp::LOAD, array, operand(dst), operand(offset), -1); }
+    void store(string_view array, Value offset, Value src) { add(TacOp::STORE, array, -1, operand(offset), operand(src)); }
+    void assign(string_view name, Value src) { add(TacOp::ASSIGN, name, -1, operand(src), -1); }
+    void binary(Value dst, Value a, string_view op, Value b) { add(TacOp::BINARY, op, operand(dst), operand(a), operand(b)); }
+    void unary(Value dst, string_view op, Value a) { add(TacOp::UNARY, op, operand(dst), operand(a), -1); }
+    void param(Value a) { add(TacOp::PARAM, {}, -1, operand(a), -1); }
+    void call(Value dst, string_view func, int nargs) { add(TacOp::CALL, func, operand(dst), -1, nargs); }
+    void cond_jump(Value a, int l) { add(TacOp::COND_JUMP, {}, l, operand(a), -1); }
+    void branch(Value a, string_view op, Value b, int l) { add(TacOp::BRANCH, op, l, operand(a), operand(b)); }
+    void jump(int l) { add(TacOp::JUMP, {}, l, -1, -1); }
+    void label(int l) { add(TacOp::LABEL, {}, l, -1, -1); }
+    void ret(Value a) { add(TacOp::RETURN, {}, -1, operand(a), -1); }
+};
+
+// Only tallies instructions by kind, for dry runs and statistics
+class CountingEmitter {
+public:
+    array<uint64_t, (size_t)TacOp::COUNT> counts = {};
+
+    void begin() {}
+    void end() {}
+
+    void comment(string_view) { counts[(size_t)TacOp::COMMENT]++; }
+    void blank() {}
+
+    void copy(Temp, Value) { counts[(size_t)TacOp::COPY]++; }
+    void load(Value, string_view, Value) { counts[(size_t)TacOp::LOAD]++; }
+    void store(string_view, Value, Value) { counts[(size_t)TacOp::STORE]++; }
+    void assign(string_view, Value) { counts[(size_t)TacOp::ASSIGN]++; }
+    void binary(Value, Value, string_view, Value) { counts[(size_t)TacOp::BINARY]++; }
+    void unary(Value, string_view, Value) { counts[(size_t)TacOp::UNARY]++; }
+    void param(Value) { counts[(size_t)TacOp::PARAM]++; }
+    void call(Value, string_view, int) { counts[(size_t)TacOp::CALL]++; }
+    void cond_jump(Value, int) { counts[(size_t)TacOp::COND_JUMP]++; }
+    void branch(Value, string_view, Value, int) { counts[(size_t)TacOp::BRANCH]++; }
+    void jump(int) { counts[(size_t)TacOp::JUMP]++; }
+    void label(int) { counts[(size_t)TacOp::LABEL]++; }
+    void ret(Value) { counts[(size_t)TacOp::RETURN]++; }
+
+    uint64_t instructions() const {
+        uint64_t total = 0;
+        for (size_t k = 0; k < counts.size(); k++) {
+            if (k != (size_t)TacOp::COMMENT && k != (size_t)TacOp::LABEL) total += counts[k];
+        }
+        return total;
+    }
+
+    void print(ostream &out) const {
+        out << "TAC instruction counts:" << endl;
+        for (size_t k = 0; k < counts.size(); k++) {
+            if (counts[k]) out << "  " << TAC_OP_NAMES[k] << ": " << counts[k] << endl;
+        }
+        out << "  total instructions: " << instructions() << endl;
+    }
+};
+
+#endif // EMITTER_H
@@ -0,0 +1,104 @@
+#ifndef FRAME_LAYOUT_H
+#define FRAME_LAYOUT_H
+
+#include "ast_visitor.h"
+#include "pass_manager.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Stack frame layout for the locals of each function (-O1).
+//
+// Every local variable and array gets an offset from the frame base. Storage is
+// allocated like a stack that follows the block structure: a block starts at
+// the offset where its parent stood when it opened and gives everything back
+// when it closes, so sibling blocks, whose locals are never live at the same
+// time, share the same slots. Each variable is aligned to its element size and
+// the frame is rounded up to FRAME_ALIGN. Parameters are not part of the frame.
+
+const uint32_t FRAME_ALIGN = 8;
+
+struct FrameSlot {
+    str_id name;
+    uint32_t offset;
+    uint32_t size;
+};
+
+struct FrameLayout {
+    node_id func;
+    vector<FrameSlot> slots;   // in declaration order
+    uint32_t size = 0;         // with sibling scopes sharing storage
+    uint32_t unshared_size = 0; // if every local had storage of its own
+};
+
+class FrameLayoutBuilder : public ASTVisitor<> {
+private:
+    FrameLayout *layout = nullptr;
+    uint32_t top = 0;      // next free offset
+    uint32_t unshared = 0; // offset if nothing were ever given back
+
+    static uint32_t align(uint32_t offset, uint32_t to) { return (offset + to - 1) / to * to; }
+
+public:
+    vector<FrameLayout> layouts;
+
+    FrameLayoutBuilder(const ASTArena &ast) : ASTVisitor(ast) {}
+
+    void visit_func_decl(node_id id) override {
+        layouts.push_back({id, {}, 0, 0});
+        layout = &layouts.back();
+        top = unshared = 0;
+        visit(ast.func_decl(id).body);
+        layout->size = align(layout->size, FRAME_ALIGN);
+        layout->unshared_size = align(unshared, FRAME_ALIGN);
+        layout = nullptr;
+    }
+
+    void visit_block(node_id id) override {
+        uint32_t saved = top;
+        visit_children(id);
+        top = saved;
+    }
+
+    void visit_decl(node_id id) override {
+        if (!layout) return; // globals have static storage
+        const DeclNode &d = ast.decl(id);
+        uint32_t elem = element_size(ast.str(d.type));
+        for (uint32_t i = 0; i < d.num_vars; i++) {
+            const DeclVar &v = ast.decl_var(d, i);
+            uint32_t size = elem * (v.array_size > 0 ? v.array_size : 1);
+            top = align(top, elem);
+            layout->slots.push_back({v.name, top, size});
+            top += size;
+            layout->size = max(layout->size, top);
+            unshared = align(unshared, elem) + size;
+        }
+    }
+
+    // Declarations only appear as statements
+    void visit_expr_stmt(node_id) override {}
+    void visit_return(node_id) override {}
+};
+
+class FrameLayoutPass : public Pass {
+public:
+    string name() const override { return "frame-layout"; }
+    vector<string> dependencies() const override { return {"verify-ast"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        FrameLayoutBuilder builder(ctx.ast);
+        builder.visit(ctx.root);
+        for (auto &layout : builder.layouts) {
+            ctx.outlog << "Frame layout for function " << ctx.ast.str(ctx.ast.func_decl(layout.func).name) << ": "
+                       << layout.size << " bytes (" << layout.unshared_size << " without slot sharing)" << endl;
+            for (auto &slot : layout.slots) {
+                ctx.outlog << "  " << ctx.ast.str(slot.name) << ": offset " << slot.offset << ", size " << slot.size << endl;
+            }
+        }
+        return true;
+    }
+};
+
+#endif // FRAME_LAYOUT_H
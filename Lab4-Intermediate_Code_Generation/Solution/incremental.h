@@ -0,0 +1,289 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "symbol_table.h"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Incremental compilation at the granularity of top-level units.
+//
+// A session remembers, for every unit (a global declaration or a function
+// definition) of the previous version of a file: its text, its AST, the global
+// symbols it declared, its diagnostics and the global symbols its identifiers
+// resolved to when it was checked. On a new version the text is split into
+// units again and each unit is matched by its exact text against the old ones.
+// A matching unit is reused, without being lexed, parsed or checked, if every
+// identifier in it still resolves to a global with the same signature; its
+// symbols are declared again and its diagnostics are moved to its new lines.
+// Everything else is parsed on its own. A changed function signature thus
+// reparses exactly the units that mention the function, its callers among them.
+//
+// Units are processed in file order with a fresh global scope, so a unit sees
+// the globals of the units before it, as in a full parse.
+
+// A top-level unit of the source: [begin, end) and the line it starts on
+struct SourceSpan {
+    size_t begin, end;
+    int line;
+};
+
+// Splits source text into top-level units: a unit ends at a ';' or at a '}'
+// that closes its outermost brace. Comments are skipped.
+inline vector<SourceSpan> split_units(const string &text) {
+    vector<SourceSpan> spans;
+    size_t i = 0, n = text.size(), begin = string::npos;
+    int line = 1, begin_line = 1, depth = 0;
+    while (i < n) {
+        char c = text[i];
+        if (c == '\n') {
+            line++;
+            i++;
+            continue;
+        }
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && text[i + 1] == '/') {
+            while (i < n && text[i] != '\n') i++;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && text[i + 1] == '*') {
+            size_t close = text.find("*/", i + 2);
+            size_t stop = close == string::npos ? n : close + 2;
+            for (; i < stop; i++) line += text[i] == '\n';
+            continue;
+        }
+        if (begin == string::npos) {
+            begin = i;
+            begin_line = line;
+        }
+        i++;
+        if (c == '{') depth++;
+        else if (c == '}' && depth > 0) depth--;
+        if ((c == ';' || c == '}') && depth == 0) {
+            spans.push_back({begin, i, begin_line});
+            begin = string::npos;
+        }
+    }
+    if (begin != string::npos) spans.push_back({begin, n, begin_line});
+    return spans;
+}
+
+// Distinct identifiers of a unit, keywords included (they never name a global)
+inline vector<string> unit_identifiers(string_view text) {
+    vector<string> ids;
+    unordered_set<string_view> seen;
+    for (size_t i = 0; i < text.size();) {
+        char c = text[i];
+        if (isalpha((unsigned char)c) || c == '_') {
+            size_t start = i;
+            while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+            string_view id = text.substr(start, i - start);
+            if (seen.insert(id).second) ids.emplace_back(id);
+        } else if (isdigit((unsigned char)c)) {
+            while (i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '.')) i++;
+        } else {
+            i++;
+        }
+    }
+    return ids;
+}
+
+// Moves the line numbers of "At line no: N" and "At line N" messages by delta
+inline string shift_lines(const string &messages, int delta) {
+    if (delta == 0) return messages;
+    string out;
+    size_t i = 0;
+    while (i < messages.size()) {
+        size_t at = messages.find("At line ", i);
+        if (at == string::npos) break;
+        size_t num = at + 8;
+        if (messages.compare(num, 4, "no: ") == 0) num += 4;
+        size_t end = num;
+        while (end < messages.size() && isdigit((unsigned char)messages[end])) end++;
+        out.append(messages, i, num - i);
+        if (end > num) out += to_string(stoi(messages.substr(num, end - num)) + delta);
+        i = end;
+    }
+    out.append(messages, i, string::npos);
+    return out;
+}
+
+// What parsing one unit on its own produced
+struct ParsedUnit {
+    node_id node = NO_NODE; // the unit's AST, NO_NODE if it did not parse
+    int errors = 0;
+    string messages;        // as written to error.txt
+};
+
+class IncrementalSession {
+public:
+    // Parses text as a single unit starting at the given line
+    typedef function<ParsedUnit(const string &text, int line)> unit_parser;
+
+    struct Result {
+        node_id program;
+        int units = 0, reparsed = 0;
+        int errors = 0;
+        string messages;
+        int lines = 1;
+    };
+
+private:
+    struct GlobalSymbol {
+        string name, type, id_type, var_type;
+        int array_size;
+        vector<string> params, param_names;
+    };
+
+    struct Unit {
+        string text;
+        int line;
+        node_id node;
+        int errors;
+        string messages;
+        vector<GlobalSymbol> globals;                // declared by this unit
+        vector<pair<string, string>> resolved;       // identifier -> signature it saw
+    };
+
+    vector<Unit> units;
+    size_t full_size = 0; // AST nodes after the last run that parsed everything
+
+    static string signature(symbol_info *sym) {
+        if (!sym) return "-";
+        string s = sym->getidtype() + " " + sym->getvartype() + " " + to_string(sym->getarraysize());
+        for (auto &p : sym->getparamlist()) s += " " + p;
+        return s;
+    }
+
+    static GlobalSymbol capture(symbol_info *sym) {
+        return {sym->getname(), sym->gettype(), sym->getidtype(), sym->getvartype(), sym->getarraysize(),
+                sym->getparamlist(), sym->getparamname()};
+    }
+
+    static void declare(symbol_table *st, const GlobalSymbol &g) {
+        if (!st->Insert_in_table(g.name, g.type)) return;
+        symbol_info *sym = st->Lookup_in_table(g.name);
+        sym->setidtype(g.id_type);
+        sym->setvartype(g.var_type);
+        sym->setarraysize(g.array_size);
+        sym->setparamlist(g.params);
+        sym->setparamname(g.param_names);
+    }
+
+    static bool still_resolves(symbol_table *st, const Unit &u) {
+        for (auto &r : u.resolved) {
+            if (signature(st->Lookup_in_table(r.first)) != r.second) return false;
+        }
+        return true;
+    }
+
+    // Names a unit's AST declares at global level
+    static void declared_names(const ASTArena &ast, node_id unit, vector<string> &names) {
+        if (!unit) return;
+        if (ast.kind(unit) == NodeKind::FUNC_DECL) names.push_back(ast.str(ast.func_decl(unit).name));
+        if (ast.kind(unit) == NodeKind::DECL) {
+            const DeclNode &d = ast.decl(unit);
+            for (uint32_t i = 0; i < d.num_vars; i++) names.push_back(ast.str(ast.decl_var(d, i).name));
+        }
+    }
+
+public:
+    // Compiles a new version of the file. The symbol table must hold only the
+    // global scope with any imported declarations in it.
+    Result update(const string &text, ASTArena &ast, symbol_table *st, const unit_parser &parse) {
+        // Replaced units leave their nodes behind; start over once they dominate
+        if (full_size && ast.size() > 2 * full_size + 1024) {
+            ast.clear();
+            units.clear();
+        }
+
+        // old units by the hash of their text, each list in file order
+        hash<string_view> hash_text;
+        unordered_map<size_t, vector<size_t>> by_text;
+        for (size_t k = 0; k < units.size(); k++) by_text[hash_text(units[k].text)].push_back(k);
+        auto take_match = [&](const string &unit_text) -> Unit * {
+            auto it = by_text.find(hash_text(unit_text));
+            if (it == by_text.end()) return nullptr;
+            for (auto k = it->second.begin(); k != it->second.end(); ++k) {
+                if (units[*k].text == unit_text) {
+                    Unit *old = &units[*k];
+                    it->second.erase(k);
+                    return old;
+                }
+            }
+            return nullptr;
+        };
+
+        // symbols declared by units so far, to tell a new declaration from a clash
+        unordered_set<symbol_info *> declared;
+        auto note_declared = [&](const Unit &u) {
+            for (auto &g : u.globals) declared.insert(st->Lookup_in_table(g.name));
+        };
+
+        Result r;
+        vector<Unit> next;
+        for (auto &span : split_units(text)) {
+            string unit_text = text.substr(span.begin, span.end - span.begin);
+            r.units++;
+
+            Unit *old = take_match(unit_text);
+            if (old && still_resolves(st, *old)) {
+                for (auto &g : old->globals) declare(st, g);
+                old->messages = shift_lines(old->messages, span.line - old->line);
+                old->line = span.line;
+                note_declared(*old);
+                next.push_back(std::move(*old));
+                continue;
+            }
+
+            Unit u;
+            u.text = std::move(unit_text);
+            u.line = span.line;
+            for (auto &id : unit_identifiers(u.text)) {
+                u.resolved.emplace_back(id, signature(st->Lookup_in_table(id)));
+            }
+            ParsedUnit p = parse(u.text, u.line);
+            u.node = p.node;
+            u.errors = p.errors;
+            u.messages = std::move(p.messages);
+
+            vector<string> names;
+            declared_names(ast, u.node, names);
+            if (!u.node) {
+                // nothing to go by when the unit did not parse: look at the whole scope
+                st->get_global_scope()->for_each_symbol([&](symbol_info *sym) { names.push_back(sym->getname()); });
+            }
+            for (auto &name : names) {
+                symbol_info *sym = st->Lookup_in_table(name);
+                if (sym && !declared.count(sym)) {
+                    u.globals.push_back(capture(sym));
+                    declared.insert(sym);
+                }
+            }
+            r.reparsed++;
+            next.push_back(std::move(u));
+        }
+        units = std::move(next);
+
+        r.program = ast.make_program();
+        for (auto &u : units) {
+            if (u.node) ast.add_unit(r.program, u.node);
+            r.errors += u.errors;
+            r.messages += u.messages;
+        }
+        for (char c : text) r.lines += c == '\n';
+        if (r.reparsed == r.units) full_size = ast.size();
+        return r;
+    }
+};
+
+#endif // INCREMENTAL_H
@@ -0,0 +1,265 @@
+#ifndef INTERFACE_FILE_H
+#define INTERFACE_FILE_H
+
+#include "symbol_table.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Binary interface file for the global scope.
+//
+// Holds the signature of every function defined in a translation unit so other
+// units can call it without seeing its definition. Layout (native byte order,
+// recorded in the header so a file from a machine of the other order is refused):
+//
+//   iface_header
+//   iface_func   [num_funcs]
+//   iface_param  [num_params]   params of func k are [first_param, first_param+num_params)
+//   char         [strtab_size]  names, not NUL terminated
+//
+// The records are fixed size and the file is mapped read-only, so importing is
+// a bounds-checked walk over the records with no parsing.
+
+const char IFACE_MAGIC[4] = {'T', 'A', 'C', 'I'};
+const uint16_t IFACE_VERSION = 2;
+const uint16_t IFACE_BYTE_ORDER = 0x0102;
+
+struct iface_header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t num_funcs;
+    uint32_t num_params;
+    uint32_t strtab_size;
+};
+
+struct iface_func
+{
+    uint32_t name_off;
+    uint16_t name_len;
+    uint8_t ret_type;
+    uint8_t reserved;
+    uint32_t first_param;
+    uint32_t num_params;
+};
+
+struct iface_param
+{
+    uint32_t name_off;
+    uint16_t name_len;
+    uint8_t type;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(iface_header) == 20, "interface header layout changed");
+static_assert(sizeof(iface_func) == 16, "interface function record layout changed");
+static_assert(sizeof(iface_param) == 8, "interface parameter record layout changed");
+
+const char *const IFACE_TYPES[] = {"int", "float", "void", "error"};
+const int IFACE_NUM_TYPES = 4;
+
+inline uint8_t iface_encode_type(const string &type)
+{
+    for (int i = 0; i < IFACE_NUM_TYPES; i++)
+    {
+        if (type == IFACE_TYPES[i]) return i;
+    }
+    return 3; // error
+}
+
+// Writes every func_def of the global scope except those named in skip
+// (functions that were themselves imported). Returns false and sets reason on failure.
+inline bool export_interface(scope_table *global, const string &path, const set<string> &skip, string &reason)
+{
+    vector<iface_func> funcs;
+    vector<iface_param> params;
+    string strtab;
+
+    auto add_string = [&](const string &s, uint32_t &off, uint16_t &len)
+    {
+        off = strtab.size();
+        len = s.size();
+        strtab += s;
+    };
+
+    global->for_each_symbol([&](symbol_info *sym)
+    {
+        if (sym->getidtype() != "func_def" || skip.count(sym->getname())) return;
+
+        iface_func f = {};
+        add_string(sym->getname(), f.name_off, f.name_len);
+        f.ret_type = iface_encode_type(sym->getvartype());
+        f.first_param = params.size();
+        f.num_params = sym->getparamlist().size();
+
+        const vector<string> &types = sym->getparamlist();
+        const vector<string> &names = sym->getparamname();
+        for (size_t i = 0; i < types.size(); i++)
+        {
+            iface_param p = {};
+            add_string(i < names.size() ? names[i] : string("_null_"), p.name_off, p.name_len);
+            p.type = iface_encode_type(types[i]);
+            params.push_back(p);
+        }
+        funcs.push_back(f);
+    });
+
+    iface_header h = {};
+    memcpy(h.magic, IFACE_MAGIC, sizeof(h.magic));
+    h.version = IFACE_VERSION;
+    h.byte_order = IFACE_BYTE_ORDER;
+    h.num_funcs = funcs.size();
+    h.num_params = params.size();
+    h.strtab_size = strtab.size();
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out)
+    {
+        reason = "cannot open " + path + " for writing";
+        return false;
+    }
+    out.write((const char *)&h, sizeof(h));
+    out.write((const char *)funcs.data(), funcs.size() * sizeof(iface_func));
+    out.write((const char *)params.data(), params.size() * sizeof(iface_param));
+    out.write(strtab.data(), strtab.size());
+    if (!out)
+    {
+        reason = "write to " + path + " failed";
+        return false;
+    }
+    return true;
+}
+
+// Maps an interface file and declares its functions in the current scope of st.
+// A function already present with the same signature is skipped, so overlapping
+// interfaces can be imported together; a conflicting one is reported in conflicts.
+// Returns the number of functions imported, or -1 with reason set if the file is unusable.
+inline int import_interface(symbol_table *st, const string &path, vector<string> &imported,
+                            vector<string> &conflicts, string &reason)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        reason = "cannot open " + path;
+        return -1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)sizeof(iface_header))
+    {
+        close(fd);
+        reason = path + " is not an interface file";
+        return -1;
+    }
+    size_t size = sb.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        reason = "cannot map " + path;
+        return -1;
+    }
+
+    const char *base = (const char *)map;
+    iface_header h;
+    memcpy(&h, base, sizeof(h));
+
+    uint64_t expected = sizeof(iface_header) + (uint64_t)h.num_funcs * sizeof(iface_func) +
+                        (uint64_t)h.num_params * sizeof(iface_param) + h.strtab_size;
+    if (memcmp(h.magic, IFACE_MAGIC, sizeof(h.magic)) != 0)
+    {
+        reason = path + " is not an interface file";
+    }
+    else if (h.byte_order == (uint16_t)(IFACE_BYTE_ORDER << 8 | IFACE_BYTE_ORDER >> 8))
+    {
+        reason = path + " was written with a different byte order";
+    }
+    else if (h.version != IFACE_VERSION)
+    {
+        reason = path + " has interface version " + to_string(h.version) + ", expected " + to_string(IFACE_VERSION);
+    }
+    else if (expected != size)
+    {
+        reason = path + " is truncated or corrupt";
+    }
+    if (!reason.empty())
+    {
+        munmap(map, size);
+        return -1;
+    }
+
+    const iface_func *funcs = (const iface_func *)(base + sizeof(iface_header));
+    const iface_param *params = (const iface_param *)(funcs + h.num_funcs);
+    const char *strtab = (const char *)(params + h.num_params);
+
+    auto in_bounds = [&](uint32_t off, uint16_t len) { return (uint64_t)off + len <= h.strtab_size; };
+    auto type_name = [](uint8_t t) { return string(IFACE_TYPES[t < IFACE_NUM_TYPES ? t : 3]); };
+
+    // Check every record before declaring anything, so a corrupt file never
+    // leaves some of its functions behind in the global scope
+    for (uint32_t k = 0; k < h.num_funcs && reason.empty(); k++)
+    {
+        const iface_func &f = funcs[k];
+        if (!in_bounds(f.name_off, f.name_len) || (uint64_t)f.first_param + f.num_params > h.num_params)
+        {
+            reason = path + " is truncated or corrupt";
+        }
+        for (uint32_t i = 0; i < f.num_params && reason.empty(); i++)
+        {
+            const iface_param &p = params[f.first_param + i];
+            if (!in_bounds(p.name_off, p.name_len)) reason = path + " is truncated or corrupt";
+        }
+    }
+    if (!reason.empty())
+    {
+        munmap(map, size);
+        return -1;
+    }
+
+    int count = 0;
+    for (uint32_t k = 0; k < h.num_funcs; k++)
+    {
+        const iface_func &f = funcs[k];
+        string_view name(strtab + f.name_off, f.name_len);
+
+        vector<string> types, names;
+        types.reserve(f.num_params);
+        names.reserve(f.num_params);
+        for (uint32_t i = 0; i < f.num_params; i++)
+        {
+            const iface_param &p = params[f.first_param + i];
+            types.push_back(type_name(p.type));
+            names.emplace_back(strtab + p.name_off, p.name_len);
+        }
+
+        if (st->Insert_in_table(name, "ID"))
+        {
+            symbol_info *sym = st->Lookup_in_table(name);
+            sym->setidtype("func_def");
+            sym->setvartype(type_name(f.ret_type));
+            sym->setparamlist(std::move(types));
+            sym->setparamname(std::move(names));
+            imported.emplace_back(name);
+            count++;
+        }
+        else
+        {
+            symbol_info *sym = st->Lookup_in_table(name);
+            if (sym->getidtype() != "func_def" || sym->getvartype() != type_name(f.ret_type) || sym->getparamlist() != types)
+            {
+                conflicts.emplace_back(name);
+            }
+        }
+    }
+
+    munmap(map, size);
+    return count;
+}
+
+#endif // INTERFACE_FILE_H
@@ -0,0 +1,152 @@
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include "ast.h"
+#include "tac_ir.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Pass manager for everything that runs after parsing.
+//
+// A pass names the passes it depends on, the passes it must run before if they
+// are registered, and the lowest optimization level it runs at. The manager
+// runs the registered passes in that order (ties keep registration order),
+// skips those below the requested -O level or disabled by name, skips anything
+// that depends on a skipped pass, and times each pass that runs.
+
+struct PassContext {
+    ASTArena &ast;
+    node_id root;
+    TacProgram &tac; // built by the tac pass, empty before it
+    ofstream &outlog;
+    ofstream &outerror;
+    ofstream &outcode;
+    int opt_level;
+};
+
+class Pass {
+public:
+    virtual ~Pass() {}
+    virtual string name() const = 0;
+    virtual vector<string> dependencies() const { return {}; }
+    // Ordering only: a pass that is not registered or is skipped is ignored
+    virtual vector<string> run_before() const { return {}; }
+    virtual int min_opt_level() const { return 0; }
+    // Returns false to stop the pipeline
+    virtual bool run(PassContext &ctx) = 0;
+};
+
+class PassManager {
+private:
+    struct pass_timing {
+        string name;
+        double ms;
+    };
+
+    vector<unique_ptr<Pass>> passes;
+    set<string> disabled;
+    vector<pass_timing> timings;
+
+    int find(const string &name) const {
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (passes[i]->name() == name) return i;
+        }
+        return -1;
+    }
+
+    // Depth-first topological order; state: 0 unvisited, 1 in progress, 2 done
+    bool order(int i, vector<int> &state, vector<int> &out, string &reason) const {
+        if (state[i] == 2) return true;
+        if (state[i] == 1) {
+            reason = "dependency cycle through pass " + passes[i]->name();
+            return false;
+        }
+        state[i] = 1;
+        for (auto &dep : passes[i]->dependencies()) {
+            int d = find(dep);
+            if (d < 0) {
+                reason = "pass " + passes[i]->name() + " depends on unknown pass " + dep;
+                return false;
+            }
+            if (!order(d, state, out, reason)) return false;
+        }
+        for (size_t j = 0; j < passes.size(); j++) {
+            for (auto &later : passes[j]->run_before()) {
+                if (later == passes[i]->name() && !order(j, state, out, reason)) return false;
+            }
+        }
+        state[i] = 2;
+        out.push_back(i);
+        return true;
+    }
+
+public:
+    void add(unique_ptr<Pass> pass) {
+        passes.push_back(std::move(pass));
+    }
+
+    void disable(const string &name) {
+        disabled.insert(name);
+    }
+
+    bool has_pass(const string &name) const {
+        return find(name) >= 0;
+    }
+
+    // Runs the pipeline. Returns false with reason set if it cannot be ordered
+    // or a pass fails.
+    bool run(PassContext &ctx, string &reason) {
+        vector<int> state(passes.size(), 0), sequence;
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (!order(i, state, sequence, reason)) return false;
+        }
+
+        set<string> skipped;
+        for (int i : sequence) {
+            Pass &pass = *passes[i];
+            if (pass.min_opt_level() > ctx.opt_level) {
+                skipped.insert(pass.name()); // not part of this -O level, not worth a log line
+                continue;
+            }
+            bool skip = disabled.count(pass.name());
+            for (auto &dep : pass.dependencies()) {
+                if (skipped.count(dep)) skip = true;
+            }
+            if (skip) {
+                skipped.insert(pass.name());
+                ctx.outlog << "Pass " << pass.name() << " skipped" << endl;
+                continue;
+            }
+
+            auto start = chrono::steady_clock::now();
+            bool ok = pass.run(ctx);
+            auto end = chrono::steady_clock::now();
+            timings.push_back({pass.name(), chrono::duration<double, milli>(end - start).count()});
+            if (!ok) {
+                reason = "pass " + pass.name() + " failed";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void print_timings(ostream &out) const {
+        double total = 0;
+        for (auto &t : timings) total += t.ms;
+        out << "Pass timings (ms):" << endl;
+        for (auto &t : timings) {
+            out << "  " << left << setw(24) << t.name << right << fixed << setprecision(3) << setw(10) << t.ms << endl;
+        }
+        out << "  " << left << setw(24) << "total" << right << fixed << setprecision(3) << setw(10) << total << endl;
+    }
+};
+
+#endif // PASS_MANAGER_H
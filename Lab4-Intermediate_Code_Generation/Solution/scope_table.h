@@ -1,14 +1,27 @@
+#ifndef SCOPE_TABLE_H
+#define SCOPE_TABLE_H
+
 #include "symbol_info.h"
+#include "symtab_stats.h"
+#include "../../common/scoped_map.h"
+
+// Symbols of every open scope live in one ScopedMap owned by symbol_table
+typedef ScopedMap<string, unique_ptr<symbol_info>, fnv1a_hash, binding_stack_storage> symbol_map;
 
+// One open scope: its ID, its parent and the level of the symbol map holding its symbols
 class scope_table
 {
 private:
-    symbol_info** chains;
+    symbol_map *symbols;
+    int level;
     int tbl_size;
     int num_chld = 0;
     int ID;
     scope_table *parent_scope = NULL;
-    int hash_func(string symbol)
+
+    // bucket a symbol is listed under in the log; the layout of the original chained
+    // table, kept for printing only
+    int hash_func(string_view symbol) const
     {
         int sum = 0;
         for (int i = 0; i < symbol.size(); i++)
@@ -17,26 +30,29 @@ private:
         }
         return sum%tbl_size;
     }
-public:
-    scope_table(){}
-    scope_table(int n, int ID)
-    {
-        tbl_size = n;
 
-        chains = new symbol_info*[n];
-
-        for(int i = 0; i < n; i++)
+    // symbols of this scope ordered by bucket, each bucket in insertion order
+    vector<pair<int, symbol_info*>> layout()
+    {
+        vector<pair<int, symbol_info*>> syms;
+        symbols->for_each_in_scope(level, [&](const string &name, unique_ptr<symbol_info> &sym)
         {
-            chains[i] = NULL;
-        }
-        this->ID = ID;
+            syms.emplace_back(hash_func(name), sym.get());
+        });
+        stable_sort(syms.begin(), syms.end(), [](const pair<int, symbol_info*> &a, const pair<int, symbol_info*> &b)
+        {
+            return a.first < b.first;
+        });
+        return syms;
     }
+public:
+    scope_table(symbol_map *symbols, int level, int n, int ID)
+        : symbols(symbols), level(level), tbl_size(n), ID(ID) {}
 
     void set_prnt(scope_table *table)
     {
         parent_scope = table;
         if(parent_scope!=NULL) parent_scope->incrs_chld();
-        //set_scope_table_ID();
     }
 
     scope_table* get_prnt()
@@ -44,12 +60,6 @@ public:
         return parent_scope;
     }
 
-    // void set_scope_table_ID()
-    // {
-    //     if(parent_scope) ID = parent_scope->getID()+"."+to_string(parent_scope->get_num_chld());
-    //     else ID = "1";
-    // }
-
     int get_num_chld()
     {
         return num_chld;
@@ -65,116 +75,24 @@ public:
         return ID;
     }
 
-    symbol_info* Lookup_in_scope(string name)
-    {
-        int pos=0;
-        int hash_val = hash_func(name);
-        symbol_info *curr_sym = chains[hash_val];
-
-        while(curr_sym != NULL)
-        {
-            if (curr_sym->getname() == name)
-            {
-                return curr_sym;
-            }
-            else
-            {
-                pos++;
-                curr_sym = curr_sym->get_next();
-            }
-        }
-
-        return curr_sym;
-    }
-
-    bool Insert_in_scope(string name, string type)
+    // binding-stack depth of each symbol of this scope: 1 plus the outer bindings it shadows
+    vector<int> binding_depths()
     {
-        int pos = 0;
-        symbol_info *new_sym = new symbol_info(name,type);
-
-        int hash_val = hash_func(name);
-
-        if(chains[hash_val]==NULL)
+        vector<int> depths;
+        symbols->for_each_in_scope(level, [&](const string &name, unique_ptr<symbol_info> &)
         {
-            chains[hash_val] = new_sym;
-            return true;
-        }
-        else
-        {
-            if (chains[hash_val]->getname() == name)
-            {
-                return false;
-            }
-
-            pos++;
-            symbol_info *buffer = chains[hash_val];
-            symbol_info *curr_sym = chains[hash_val]->get_next();
-
-            while(true)
-            {
-                if(curr_sym == NULL)
-                {
-                    buffer->set_next(new_sym);
-                    return true;
-                }
-                else
-                {
-                    if (curr_sym->getname() == name)
-                    {
-                        return false;
-                    }
-                    pos++;
-                    buffer = curr_sym;
-                    curr_sym = curr_sym->get_next();
-                }
-            }
-        }
+            depths.push_back(symbols->binding_depth(name));
+        });
+        return depths;
     }
 
-    bool Delete_from_scope(string name)
+    // visit every symbol in bucket order
+    template <class F>
+    void for_each_symbol(F f)
     {
-        int pos = 0;
-        int hash_val = hash_func(name);
-        symbol_info *curr_sym = chains[hash_val];
-
-
-        if(curr_sym == NULL)
-        {
-            return false;
-        }
-
-        else if (curr_sym->getname() == name)
-        {
-            chains[hash_val] = curr_sym->get_next();
-            curr_sym->set_next(NULL);
-            delete curr_sym;
-            curr_sym = NULL;
-            return true;
-        }
-
-        else
+        for(auto &entry : layout())
         {
-            pos++;
-            symbol_info *buffer = curr_sym;
-            curr_sym = curr_sym->get_next();
-            while(curr_sym!=NULL)
-            {
-                if (curr_sym->getname() == name)
-                {
-                    buffer->set_next(curr_sym->get_next());
-                    curr_sym->set_next(NULL);
-                    delete curr_sym;
-                    curr_sym = NULL;
-                    return true;
-                }
-                else
-                {
-                    pos++;
-                    buffer = curr_sym;
-                    curr_sym = curr_sym->get_next();
-                }
-            }
-            return false;
+            f(entry.second);
         }
     }
 
@@ -184,28 +102,29 @@ public:
     	s+="ScopeTable # "+to_string(ID)+"\n";
         //cout<<"ScopeTable # "<<ID<<endl;
 
-        for(int i = 0; i < tbl_size; i++)
+        vector<pair<int, symbol_info*>> syms = layout();
+        for(size_t k = 0; k < syms.size(); )
         {
-            if(chains[i]!=NULL)
-            {
-            	s+=to_string(i)+" --> ";
+            int i = syms[k].first;
+            s+=to_string(i)+" --> ";
             	//cout<<i<<" --> ";
 
-		        symbol_info *curr_sym = chains[i];
-
-		        while(curr_sym!=NULL)
+		        for(; k < syms.size() && syms[k].first == i; k++)
 		        {
+		        	symbol_info *curr_sym = syms[k].second;
 		        	s+="\n< "+curr_sym->getname()+" : "+curr_sym->gettype()+" >\n";
                     if (curr_sym->getidtype() == "func_def")
                     {
                         s+="Function Definition\n";
                         s+="Return Type: "+curr_sym->getvartype()+"\n";
-                        s+="Number of Parameters: "+to_string(curr_sym->getparamlist().size())+"\n";
+                        const vector<string>& params = curr_sym->getparamlist();
+                        const vector<string>& names = curr_sym->getparamname();
+                        s+="Number of Parameters: "+to_string(params.size())+"\n";
                         s+="Parameter Details: ";
-                        for(int i = 0; i<curr_sym->getparamlist().size(); i++)
+                        for(int i = 0; i<params.size(); i++)
                         {
-                            s+=curr_sym->getparamlist()[i] + " " + curr_sym->getparamname()[i];
-                            if(i!=curr_sym->getparamlist().size()-1) s+=", ";
+                            s+=params[i] + " " + names[i];
+                            if(i!=params.size()-1) s+=", ";
                         }
                         //cout<<"Function Definition"<<endl;
                     }
@@ -228,32 +147,15 @@ public:
                         //cout<<"Error"<<endl;
                     }
 		            //cout<<"< "<<curr_sym->getname()<<" : "<<curr_sym->gettype()<<" > ";
-		            curr_sym = curr_sym->get_next();
 		        }
 				s+="\n";
 		        //cout<<endl;
-            }
         }
 		s+="\n";
 		outlog<<s;
         //cout<<endl;
         //return s;
     }
+};
 
-    ~scope_table()
-    {
-        //cout<<"delete scope"<<endl;
-        for(int i = 0; i<tbl_size; i++)
-        {
-            while(chains[i]!=NULL)
-            {
-                symbol_info *buffer = chains[i];
-                chains[i] = chains[i]->get_next();
-                buffer->set_next(NULL);
-                delete buffer;
-                buffer = NULL;
-            }
-        }
-        delete[] chains;
-    }
-};
\ No newline at end of file
+#endif // SCOPE_TABLE_H
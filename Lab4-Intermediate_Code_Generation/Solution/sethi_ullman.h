@@ -0,0 +1,184 @@
+#ifndef SETHI_ULLMAN_H
+#define SETHI_ULLMAN_H
+
+#include "ast_visitor.h"
+#include "pass_manager.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Sethi-Ullman evaluation order (-O1).
+//
+// Labels every expression with its Ershov number, the number of temporaries
+// that must be live at once to evaluate it, and marks binary operators whose
+// right operand needs more than the left one RIGHT_FIRST, so the code generator
+// evaluates the heavier side first. Only operators whose operands are both
+// free of side effects are reordered; && and || keep their order, as do calls,
+// their arguments and assignments.
+//
+// The need of a leaf is 1. An operator whose operands need l and r needs
+// max(l, r) when they differ and l + 1 when they are equal; evaluated left to
+// right it needs max(l, r + 1). An array access holds the index and the element
+// size at once, and a call holds every evaluated argument until the call.
+
+class SethiUllmanLabeller : public ASTVisitor<uint32_t, ASTArena> {
+private:
+    // Needs are memoized per node: shared subexpressions are labelled once
+    vector<uint32_t> need;
+    vector<uint32_t> need_in_order; // without reordering, for the report
+    vector<uint8_t> pure;           // 0 unknown, 1 pure, 2 has side effects
+
+    bool is_pure(node_id id) {
+        if (!id) return true;
+        if (!pure[id]) {
+            NodeKind k = ast.kind(id);
+            bool p = k != NodeKind::ASSIGN && k != NodeKind::FUNC_CALL;
+            ast.for_each_child(id, [&](node_id child) { p = p && is_pure(child); });
+            pure[id] = p ? 1 : 2;
+        }
+        return pure[id] == 1;
+    }
+
+    uint32_t label(node_id id) {
+        if (!id) return 0;
+        if (!need[id]) visit(id);
+        return need[id];
+    }
+
+    uint32_t in_order(node_id id) { return id ? need_in_order[id] : 0; }
+
+    uint32_t set_need(node_id id, uint32_t n, uint32_t n_in_order) {
+        need[id] = n;
+        need_in_order[id] = n_in_order;
+        return n;
+    }
+
+    // An expression evaluated on its own by a statement
+    void label_root(node_id id) {
+        if (!id) return;
+        label(id);
+        peak = max(peak, need[id]);
+        peak_in_order = max(peak_in_order, need_in_order[id]);
+        total += need[id];
+        total_in_order += need_in_order[id];
+    }
+
+    static uint32_t combine(uint32_t l, uint32_t r) { return l == r ? l + 1 : max(l, r); }
+
+public:
+    int reordered = 0;
+    uint32_t peak = 0, peak_in_order = 0;
+    uint64_t total = 0, total_in_order = 0;
+
+    SethiUllmanLabeller(ASTArena &ast)
+        : ASTVisitor(ast), need(ast.size() + 1), need_in_order(ast.size() + 1), pure(ast.size() + 1) {}
+
+    uint32_t visit_var(node_id id) override {
+        node_id index = ast.var(id).index;
+        if (!index) return set_need(id, 1, 1);
+        label(index);
+        return set_need(id, max(need[index], 2u), max(need_in_order[index], 2u));
+    }
+
+    uint32_t visit_const(node_id id) override { return set_need(id, 1, 1); }
+
+    uint32_t visit_binary_op(node_id id) override {
+        const BinaryOpNode &b = ast.binary_op(id);
+        uint32_t l = label(b.left), r = label(b.right);
+        uint32_t n_in_order = max(in_order(b.left), in_order(b.right) + 1);
+
+        const string &op = ast.str(b.op);
+        bool may_reorder = op != "&&" && op != "||" && is_pure(b.left) && is_pure(b.right);
+        bool right_first = may_reorder && r > l;
+        ast.set_flag(id, RIGHT_FIRST, right_first);
+        if (right_first) reordered++;
+        return set_need(id, may_reorder ? combine(l, r) : max(l, r + 1), n_in_order);
+    }
+
+    uint32_t visit_unary_op(node_id id) override {
+        node_id expr = ast.unary_op(id).expr;
+        label(expr);
+        return set_need(id, max(need[expr], 1u), max(need_in_order[expr], 1u));
+    }
+
+    uint32_t visit_assign(node_id id) override {
+        const AssignNode &a = ast.assign(id);
+        node_id rhs = a.rhs, index = ast.var(a.lhs).index;
+        label(rhs);
+        uint32_t n = max(need[rhs], 1u), n_in_order = max(need_in_order[rhs], 1u);
+        if (index) {
+            // the value stays live while the offset is computed
+            label(index);
+            n = max(n, 1 + max(need[index], 2u));
+            n_in_order = max(n_in_order, 1 + max(need_in_order[index], 2u));
+        }
+        return set_need(id, n, n_in_order);
+    }
+
+    uint32_t visit_func_call(node_id id) override {
+        const FuncCallNode &call = ast.func_call(id);
+        uint32_t n = 1, n_in_order = 1;
+        for (uint32_t i = 0; i < call.num_args; i++) {
+            node_id arg = ast.call_arg(call, i);
+            label(arg);
+            n = max(n, i + need[arg]);
+            n_in_order = max(n_in_order, i + need_in_order[arg]);
+        }
+        return set_need(id, n, n_in_order);
+    }
+
+    // Statements only pass the labelling on to their expressions
+
+    uint32_t visit_expr_stmt(node_id id) override {
+        label_root(ast.expr_stmt(id).expr);
+        return 0;
+    }
+
+    uint32_t visit_if(node_id id) override {
+        const IfNode &s = ast.if_stmt(id);
+        label_root(s.condition);
+        visit(s.then_block);
+        visit(s.else_block);
+        return 0;
+    }
+
+    uint32_t visit_while(node_id id) override {
+        label_root(ast.while_stmt(id).condition);
+        visit(ast.while_stmt(id).body);
+        return 0;
+    }
+
+    uint32_t visit_for(node_id id) override {
+        const ForNode &s = ast.for_stmt(id);
+        visit(s.init);
+        visit(s.condition);
+        visit(s.body);
+        label_root(s.update);
+        return 0;
+    }
+
+    uint32_t visit_return(node_id id) override {
+        label_root(ast.return_stmt(id).expr);
+        return 0;
+    }
+};
+
+class SethiUllmanPass : public Pass {
+public:
+    string name() const override { return "sethi-ullman"; }
+    vector<string> dependencies() const override { return {"verify-ast"}; }
+    vector<string> run_before() const override { return {"tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        SethiUllmanLabeller labeller(ctx.ast);
+        labeller.visit(ctx.root);
+        ctx.outlog << "Sethi-Ullman ordering: " << labeller.reordered << " operators evaluate their right operand first; "
+                   << "temporaries needed per expression: peak " << labeller.peak_in_order << " -> " << labeller.peak
+                   << ", sum " << labeller.total_in_order << " -> " << labeller.total << endl;
+        return true;
+    }
+};
+
+#endif // SETHI_ULLMAN_H
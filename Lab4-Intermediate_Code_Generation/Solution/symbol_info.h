@@ -2,11 +2,9 @@
 #define SYMBOL_INFO_H
 
 #include <bits/stdc++.h>
+#include "ast.h"
 using namespace std;
 
-// Forward declaration of ASTNode
-class ASTNode;
-
 class symbol_info
 {
 private:
@@ -17,55 +15,43 @@ private:
     int array_size;
     vector<string> param_list;//for functions
     vector<string> param_name;
-    symbol_info *next_sym;
-    ASTNode* ast_node; // Pointer to AST node
+    node_id ast_node; // AST node built for this grammar symbol
+    int xref_id = -1; // entry in the cross-reference index, -1 if none
 public:
     //symbol_info(){}
     symbol_info(string name, string type)
+        : sym_name(std::move(name)), sym_type(std::move(type))
     {
-        sym_name = name;
-        sym_type = type;
-        next_sym = NULL;
-        ast_node = NULL;
-    }
-
-    void set_next(symbol_info *symbol)
-    {
-        next_sym = symbol;
-    }
-
-    symbol_info* get_next()
-    {
-        return next_sym;
+        ast_node = NO_NODE;
     }
 
-    string getname()
+    const string& getname() const
     {
         return sym_name;
     }
-    string gettype()
+    const string& gettype() const
     {
         return sym_type;
     }
     
-    string getvartype()
+    const string& getvartype() const
     {
         return var_type;
     }
     
     void setvartype(string tp)
     {
-    	var_type = tp;
+    	var_type = std::move(tp);
     }
     
-    string getidtype()
+    const string& getidtype() const
     {
         return ID_type;
     }
     
     void setidtype(string tp)
     {
-    	ID_type = tp;
+    	ID_type = std::move(tp);
     }
     
     int getarraysize()
@@ -80,22 +66,22 @@ public:
     
     void setparamlist(vector<string> list)
     {
-    	param_list = list;
+    	param_list = std::move(list);
     }
     
-    vector<string> getparamlist()
+    const vector<string>& getparamlist() const
     {
     	return param_list;
     }
     
-    vector<string> getparamname()
+    const vector<string>& getparamname() const
     {
     	return param_name;
     }
     
     void setparamname(vector<string> list)
     {
-    	param_name = list;
+    	param_name = std::move(list);
     }
     
     int getparamsize()
@@ -104,22 +90,30 @@ public:
     }
 
     // New methods for AST support
-    void set_ast_node(ASTNode* node)
+    void set_ast_node(node_id node)
     {
         ast_node = node;
     }
 
-    ASTNode* get_ast_node()
+    node_id get_ast_node()
     {
         return ast_node;
     }
 
+    void setxrefid(int id)
+    {
+        xref_id = id;
+    }
+
+    int getxrefid() const
+    {
+        return xref_id;
+    }
+
     ~symbol_info()
     {
-        delete next_sym;
         param_list.clear();
         param_name.clear();
-        // Don't delete ast_node here - will be managed separately
     }
 };
 
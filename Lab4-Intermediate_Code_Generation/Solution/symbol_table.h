@@ -1,8 +1,12 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
 #include "scope_table.h"
 
 class symbol_table
 {
 private:
+    symbol_map symbols;
     scope_table *curr_scope = NULL;
     int scope_size = 10;
     int ID = 0;
@@ -18,7 +22,8 @@ public:
     void enter_scope(ofstream& outlog)
     {
         ID+=1;
-        scope_table *new_scope = new scope_table(scope_size, ID);
+        symbols.enter_scope(scope_size);
+        scope_table *new_scope = new scope_table(&symbols, symbols.depth()-1, scope_size, ID);
         new_scope->set_prnt(curr_scope);
         curr_scope = new_scope;
         outlog<<"New ScopeTable with ID "<<curr_scope->getID()<<" created"<<endl<<endl;
@@ -28,40 +33,56 @@ public:
     void exit_scope(ofstream& outlog)
     {
     	outlog<<"Scopetable with ID "<<curr_scope->getID()<<" removed"<<endl<<endl;
+        SYMTAB_STAT(symtab_counters().scope_exit(curr_scope->getID(), curr_scope->binding_depths()));
         scope_table *buffer = curr_scope;
         curr_scope = curr_scope->get_prnt();
+        symbols.exit_scope();
         delete buffer;
         buffer = NULL;
         //cout<<curr_scope->getID()<<endl;
     }
 
-    bool Insert_in_table(string name, string type)
+    bool Insert_in_table(string_view name, string_view type)
+    {
+        SYMTAB_STAT(symtab_counters().insert_calls++);
+        // the symbol is only built once the name is known to be new in this scope
+        bool inserted = symbols.try_emplace(name, [&]
+        {
+            return make_unique<symbol_info>(string(name), string(type));
+        }) != NULL;
+        SYMTAB_STAT(symtab_counters().insert_failed += !inserted);
+        return inserted;
+    }
+
+    bool Remove_from_table(string_view name)
     {
-        if(curr_scope->Insert_in_scope(name,type)) return true;
-        else return false;
+        SYMTAB_STAT(symtab_counters().delete_calls++);
+        bool removed = symbols.erase_local(name);
+        SYMTAB_STAT(symtab_counters().delete_hits += removed);
+        return removed;
     }
 
-    bool Remove_from_table(string name)
+    symbol_info* Lookup_in_table(string_view name)
     {
-        if(curr_scope->Delete_from_scope(name)) return true;
-        else return false;
+#ifdef SYMTAB_STATS
+        scoped_lookup_info info;
+        unique_ptr<symbol_info> *symbol = symbols.find(name, &info);
+        symtab_counters().scope_lookup(info.probes, symbol!=NULL);
+        symtab_counters().table_lookup(info.depth, symbol!=NULL);
+#else
+        unique_ptr<symbol_info> *symbol = symbols.find(name);
+#endif
+        return symbol ? symbol->get() : NULL;
     }
 
-    symbol_info* Lookup_in_table(string name)
+    scope_table* get_global_scope()
     {
-        symbol_info *symbol = curr_scope->Lookup_in_scope(name);
-        scope_table *buffer_scope = curr_scope->get_prnt();
-        if(symbol==NULL)
+        scope_table *buffer = curr_scope;
+        while(buffer != NULL && buffer->get_prnt() != NULL)
         {
-            while(buffer_scope!=NULL)
-            {
-                symbol = buffer_scope->Lookup_in_scope(name);
-                if(symbol!=NULL) return symbol;
-                buffer_scope = buffer_scope->get_prnt();
-            }
+            buffer = buffer->get_prnt();
         }
-        
-        return symbol;
+        return buffer;
     }
 
     void Print_current_scope()
@@ -84,7 +105,14 @@ public:
 
     ~symbol_table()
     {
-        delete curr_scope;
+        while(curr_scope!=NULL)
+        {
+            scope_table *buffer = curr_scope;
+            curr_scope = curr_scope->get_prnt();
+            delete buffer;
+        }
     }
 
 };
+
+#endif // SYMBOL_TABLE_H
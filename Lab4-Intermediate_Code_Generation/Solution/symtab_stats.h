@@ -0,0 +1,135 @@
+#ifndef SYMTAB_STATS_H
+#define SYMTAB_STATS_H
+
+// Opt-in symbol table instrumentation.
+//
+// Build with -DSYMTAB_STATS to count Insert/Lookup/Delete calls, hash probes per
+// lookup, scopes walked per table lookup and where lookups are resolved,
+// plus a histogram of binding-stack depths (how many open bindings each of its
+// names has) for every scope when it is exited. Without the
+// flag SYMTAB_STAT(...) expands to nothing and the counters do not exist.
+
+#ifdef SYMTAB_STATS
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class symtab_stats
+{
+private:
+    // hist[i] counts events of size i; grows on demand
+    static void bump(vector<uint64_t> &hist, size_t i)
+    {
+        if (hist.size() <= i) hist.resize(i + 1, 0);
+        hist[i]++;
+    }
+
+    static void write_hist(ofstream &out, const vector<uint64_t> &hist)
+    {
+        out << "[";
+        for (size_t i = 0; i < hist.size(); i++)
+        {
+            out << (i ? ", " : "") << hist[i];
+        }
+        out << "]";
+    }
+
+    struct scope_record
+    {
+        int id;
+        int symbols;
+        vector<uint64_t> binding_depths;
+    };
+
+public:
+    uint64_t insert_calls = 0, insert_failed = 0;
+    uint64_t lookup_calls = 0, lookup_hits = 0;
+    uint64_t delete_calls = 0, delete_hits = 0;
+    uint64_t probes = 0;
+    vector<uint64_t> probe_hist;       // hash probes per lookup
+    uint64_t table_lookups = 0, table_misses = 0;
+    vector<uint64_t> walk_hist;        // parent scopes walked per Lookup_in_table
+    vector<uint64_t> hit_depth_hist;   // depth (0 = current scope) that resolved a Lookup_in_table
+    vector<scope_record> scopes;
+
+    void scope_lookup(int n_probes, bool hit)
+    {
+        lookup_calls++;
+        lookup_hits += hit;
+        probes += n_probes;
+        bump(probe_hist, n_probes);
+    }
+
+    void table_lookup(int walked, bool hit)
+    {
+        table_lookups++;
+        bump(walk_hist, walked);
+        if (hit) bump(hit_depth_hist, walked);
+        else table_misses++;
+    }
+
+    void scope_exit(int id, const vector<int> &depths)
+    {
+        scope_record r = {id, (int)depths.size(), {}};
+        for (int d : depths)
+        {
+            bump(r.binding_depths, d);
+        }
+        scopes.push_back(r);
+    }
+
+    void write_json(const string &path)
+    {
+        ofstream out(path, ios::trunc);
+        out << "{" << endl;
+        out << "  \"insert\": {\"calls\": " << insert_calls << ", \"failed\": " << insert_failed << "}," << endl;
+        out << "  \"delete\": {\"calls\": " << delete_calls << ", \"hits\": " << delete_hits << "}," << endl;
+        out << "  \"scope_lookup\": {\"calls\": " << lookup_calls << ", \"hits\": " << lookup_hits
+            << ", \"probes\": " << probes << ", \"probe_histogram\": ";
+        write_hist(out, probe_hist);
+        out << "}," << endl;
+        out << "  \"table_lookup\": {\"calls\": " << table_lookups << ", \"misses\": " << table_misses
+            << ", \"scopes_walked_histogram\": ";
+        write_hist(out, walk_hist);
+        out << ", \"hits_by_depth\": ";
+        write_hist(out, hit_depth_hist);
+        // a lookup reached depth d if it walked at least d scopes out
+        out << ", \"hit_rate_by_depth\": [";
+        uint64_t reached = table_lookups;
+        for (size_t d = 0; d < hit_depth_hist.size(); d++)
+        {
+            out << (d ? ", " : "") << (reached ? (double)hit_depth_hist[d] / reached : 0.0);
+            reached -= d < walk_hist.size() ? walk_hist[d] : 0;
+        }
+        out << "]}," << endl;
+        out << "  \"scopes\": [";
+        for (size_t i = 0; i < scopes.size(); i++)
+        {
+            out << (i ? "," : "") << endl << "    {\"id\": " << scopes[i].id << ", \"symbols\": " << scopes[i].symbols
+                << ", \"binding_depth_histogram\": ";
+            write_hist(out, scopes[i].binding_depths);
+            out << "}";
+        }
+        out << endl << "  ]" << endl << "}" << endl;
+    }
+};
+
+inline symtab_stats &symtab_counters()
+{
+    static symtab_stats stats;
+    return stats;
+}
+
+#define SYMTAB_STAT(stmt) do { stmt; } while (0)
+
+#else
+
+#define SYMTAB_STAT(stmt) do { } while (0)
+
+#endif // SYMTAB_STATS
+
+#endif // SYMTAB_STATS_H
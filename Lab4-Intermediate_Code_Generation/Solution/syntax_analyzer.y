@@ -2,7 +2,22 @@
 
 #include "symbol_table.h"
 #include "ast.h"
+#include "ast_verifier.h"
+#include "constant_folding.h"
+#include "sethi_ullman.h"
+#include "frame_layout.h"
 #include "three_addr_code.h"
+#include "tac_cfg.h"
+#include "tac_inline.h"
+#include "tac_lvn.h"
+#include "tac_copy_prop.h"
+#include "tac_licm.h"
+#include "tac_liveness.h"
+#include "tac_strength.h"
+#include "tac_temp_reuse.h"
+#include "interface_file.h"
+#include "incremental.h"
+#include "xref_index.h"
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -11,15 +26,19 @@
 #define YYSTYPE symbol_info*
 
 extern FILE *yyin;
+void yyrestart(FILE *);
 int yyparse(void);
 int yylex(void);
 extern YYSTYPE yylval;
 
 symbol_table *symtbl = new symbol_table();
-ProgramNode* ast_root = new ProgramNode();
+ASTArena ast;
+node_id ast_root = NO_NODE;
 
 int lines = 1;
 int errors = 0;
+bool parsing_unit = false; // incremental mode: parsing one top-level unit on its own
+XrefBuilder *xref = NULL; // cross-reference index being built, with -xref
 ofstream outlog, outerror, outcode;
 
 string varlist=""; //for variable declarartion list
@@ -60,13 +79,17 @@ void yyerror(char *s)
 start : program
 	{
 		outlog<<"At line no: "<<lines<<" start : program "<<endl<<endl;
-		outlog<<"Symbol Table"<<endl<<endl;
-		
-		symtbl->Print_all_scope(outlog);
+		// a unit parsed on its own is not the program; its trace is thrown away
+		if(!parsing_unit)
+		{
+			outlog<<"Symbol Table"<<endl<<endl;
+			
+			symtbl->Print_all_scope(outlog);
+		}
 		
 		$$ = $1;
 		// Root of AST is the program node
-		ast_root = (ProgramNode*)$1->get_ast_node();
+		ast_root = $1->get_ast_node();
 	}
 	;
 
@@ -78,17 +101,13 @@ program : program unit
 		$$ = new symbol_info($1->getname()+"\n"+$2->getname(),"program");
 		
 		// Create/update AST node for program
-		ProgramNode* prog;
-		if($1->get_ast_node()) {
-			prog = (ProgramNode*)$1->get_ast_node();
-		} else {
-			prog = new ProgramNode();
+		node_id prog = $1->get_ast_node();
+		if(!prog) {
+			prog = ast.make_program();
 		}
 		
 		// Add the unit to the program
-		if($2->get_ast_node()) {
-			prog->add_unit($2->get_ast_node());
-		}
+		ast.add_unit(prog, $2->get_ast_node());
 		
 		$$->set_ast_node(prog);
 	}
@@ -100,10 +119,8 @@ program : program unit
 		$$ = new symbol_info($1->getname(),"program");
 		
 		// Create AST node for program with a single unit
-		ProgramNode* prog = new ProgramNode();
-		if($1->get_ast_node()) {
-			prog->add_unit($1->get_ast_node());
-		}
+		node_id prog = ast.make_program();
+		ast.add_unit(prog, $1->get_ast_node());
 		$$->set_ast_node(prog);
 	}
 	;
@@ -138,19 +155,17 @@ func_definition : type_specifier id_name LPAREN parameter_list RPAREN enter_func
 			$$ = new symbol_info($1->getname()+" "+$2->getname()+"("+$4->getname()+")\n"+$7->getname(),"func_def");	
 			
 			// Create AST node for function definition
-			FuncDeclNode* func = new FuncDeclNode($1->getname(), $2->getname());
+			node_id func = ast.make_func_decl($1->getname(), $2->getname());
 			
 			// Add parameters
 			for(int i = 0; i < paramlist.size(); i++) {
 				if(paramname[i] != "_null_") {
-					func->add_param(paramlist[i], paramname[i]);
+					ast.add_param(func, paramlist[i], paramname[i]);
 				}
 			}
 			
 			// Set body
-			if($7->get_ast_node()) {
-				func->set_body((BlockNode*)$7->get_ast_node());
-			}
+			ast.set_body(func, $7->get_ast_node());
 			
 			$$->set_ast_node(func);
 			
@@ -171,12 +186,10 @@ func_definition : type_specifier id_name LPAREN parameter_list RPAREN enter_func
 			$$ = new symbol_info($1->getname()+" "+$2->getname()+"()\n"+$6->getname(),"func_def");	
 			
 			// Create AST node for function definition
-			FuncDeclNode* func = new FuncDeclNode($1->getname(), $2->getname());
+			node_id func = ast.make_func_decl($1->getname(), $2->getname());
 			
 			// Set body
-			if($6->get_ast_node()) {
-				func->set_body((BlockNode*)$6->get_ast_node());
-			}
+			ast.set_body(func, $6->get_ast_node());
 			
 			$$->set_ast_node(func);
 			
@@ -191,6 +204,8 @@ func_definition : type_specifier id_name LPAREN parameter_list RPAREN enter_func
  		;
 
 enter_func : {
+				ast.begin_region(); // expressions are never shared between functions
+				
 				//if(symtbl->getID()!="1") goto end2; //not in global scope , doesnt work because if not inserted lots of errors come in compound statement
 				
 				is_func=1;//compound statement is coming in function definition. enter parameter variables.
@@ -215,6 +230,7 @@ enter_func : {
 					(symtbl->Lookup_in_table(func_name))->setidtype("func_def");
 					(symtbl->Lookup_in_table(func_name))->setparamlist(paramlist);//initialize parameters
 					(symtbl->Lookup_in_table(func_name))->setparamname(paramname);
+					if(xref) xref->define(symtbl->Lookup_in_table(func_name), XREF_FUNC, lines, symtbl->getID());
 				}
 				else
 				{
@@ -306,8 +322,7 @@ compound_statement : LCURL enter_scope_variables statements RCURL
 				$$ = new symbol_info("{\n}","comp_stmnt");
 				
 				// Create empty block node
-				BlockNode* block = new BlockNode();
-				$$->set_ast_node(block);
+				$$->set_ast_node(ast.make_block());
 				
 				symtbl->Print_all_scope(outlog);
 			    symtbl->exit_scope(outlog);
@@ -328,6 +343,7 @@ enter_scope_variables :
 								symtbl->Insert_in_table(paramname[i],"ID");
 								(symtbl->Lookup_in_table(paramname[i]))->setidtype("var");
 								(symtbl->Lookup_in_table(paramname[i]))->setvartype(paramlist[i]);
+								if(xref) xref->define(symtbl->Lookup_in_table(paramname[i]), XREF_PARAM, lines, symtbl->getID());
 							}
 							
 						}
@@ -354,7 +370,7 @@ var_declaration : type_specifier declaration_list SEMICOLON
 			}
 			
 			// Create AST node for variable declaration
-			DeclNode* declNode = new DeclNode($1->getname());
+			node_id declNode = ast.make_decl($1->getname());
 			
 			// Parse the varlist to add variables to the declaration node
 			stringstream _varlist(varlist);
@@ -364,12 +380,13 @@ var_declaration : type_specifier declaration_list SEMICOLON
 			{
 				if(varname.find("[") == string::npos) // normal variable
 				{
-					declNode->add_var(varname, 0);
+					ast.add_var(declNode, varname, 0);
 					
 					if(symtbl->Insert_in_table(varname,"ID"))
 					{
 						(symtbl->Lookup_in_table(varname))->setvartype($1->getname());
 						(symtbl->Lookup_in_table(varname))->setidtype("var");
+						if(xref) xref->define(symtbl->Lookup_in_table(varname), XREF_VAR, lines, symtbl->getID());
 					}
 					else
 					{
@@ -386,13 +403,14 @@ var_declaration : type_specifier declaration_list SEMICOLON
 					getline(_varname,name,'['); // get array name
 					getline(_varname,size,']'); // get array size
 					
-					declNode->add_var(name, stoi(size));
+					ast.add_var(declNode, name, stoi(size));
 					
 					if(symtbl->Insert_in_table(name,"ID"))
 					{
 						(symtbl->Lookup_in_table(name))->setvartype($1->getname());
 						(symtbl->Lookup_in_table(name))->setidtype("array");
 						(symtbl->Lookup_in_table(name))->setarraysize(stoi(size));
+						if(xref) xref->define(symtbl->Lookup_in_table(name), XREF_ARRAY, lines, symtbl->getID());
 					}
 					else
 					{
@@ -489,10 +507,8 @@ statements : statement
 			$$ = new symbol_info($1->getname(),"stmnts");
 			
 			// Create block for statements
-			BlockNode* block = new BlockNode();
-			if($1->get_ast_node()) {
-				block->add_statement((StmtNode*)$1->get_ast_node());
-			}
+			node_id block = ast.make_block();
+			ast.add_statement(block, $1->get_ast_node());
 			$$->set_ast_node(block);
 	   }
 	   | statements statement
@@ -503,17 +519,14 @@ statements : statement
 			$$ = new symbol_info($1->getname()+"\n"+$2->getname(),"stmnts");
 			
 			// Update block with new statement
-			BlockNode* block = (BlockNode*)$1->get_ast_node();
-			if($2->get_ast_node()) {
-				block->add_statement((StmtNode*)$2->get_ast_node());
-			}
+			node_id block = $1->get_ast_node();
+			ast.add_statement(block, $2->get_ast_node());
 			$$->set_ast_node(block);
 	   }
 	   | error
 	   {
 	  		$$ = new symbol_info("","stmnts");
-			BlockNode* block = new BlockNode();
-			$$->set_ast_node(block);
+			$$->set_ast_node(ast.make_block());
 	   }  
 	   | statements error
 	   {
@@ -554,21 +567,22 @@ statement : var_declaration
 			$$ = new symbol_info($1->getname(),"stmnt");
 			$$->set_ast_node($1->get_ast_node());
 	  }
-	  | FOR LPAREN expression_statement expression_statement expression RPAREN statement
+	  | FOR LPAREN expression_statement expr_region expression_statement expr_region expression RPAREN expr_region statement
 	  {
 	    	outlog<<"At line no: "<<lines<<" statement : FOR LPAREN expression_statement expression_statement expression RPAREN statement "<<endl<<endl;
-			outlog<<"for("<<$3->getname()<<$4->getname()<<$5->getname()<<")\n"<<$7->getname()<<endl<<endl;
+			outlog<<"for("<<$3->getname()<<$5->getname()<<$7->getname()<<")\n"<<$10->getname()<<endl<<endl;
 			
-			$$ = new symbol_info("for("+$3->getname()+$4->getname()+$5->getname()+")\n"+$7->getname(),"stmnt");
+			$$ = new symbol_info("for("+$3->getname()+$5->getname()+$7->getname()+")\n"+$10->getname(),"stmnt");
 			
 			// Create AST node for for loop
-			ForNode* forNode = new ForNode(
-				(ExprNode*)$3->get_ast_node(),
-				(ExprNode*)$4->get_ast_node(),
-				(ExprNode*)$5->get_ast_node(),
-				(StmtNode*)$7->get_ast_node()
+			node_id forNode = ast.make_for(
+				$3->get_ast_node(),
+				$5->get_ast_node(),
+				$7->get_ast_node(),
+				$10->get_ast_node()
 			);
 			$$->set_ast_node(forNode);
+			ast.begin_region();
 	  }
 	  | IF LPAREN expression RPAREN statement %prec LOWER_THAN_ELSE
 	  {
@@ -578,11 +592,12 @@ statement : var_declaration
 			$$ = new symbol_info("if("+$3->getname()+")\n"+$5->getname(),"stmnt");
 			
 			// Create AST node for if statement (without else)
-			IfNode* ifNode = new IfNode(
-				(ExprNode*)$3->get_ast_node(),
-				(StmtNode*)$5->get_ast_node()
+			node_id ifNode = ast.make_if(
+				$3->get_ast_node(),
+				$5->get_ast_node()
 			);
 			$$->set_ast_node(ifNode);
+			ast.begin_region();
 	  }
 	  | IF LPAREN expression RPAREN statement ELSE statement
 	  {
@@ -592,32 +607,36 @@ statement : var_declaration
 			$$ = new symbol_info("if("+$3->getname()+")\n"+$5->getname()+"\nelse\n"+$7->getname(),"stmnt");
 			
 			// Create AST node for if-else statement
-			IfNode* ifNode = new IfNode(
-				(ExprNode*)$3->get_ast_node(),
-				(StmtNode*)$5->get_ast_node(),
-				(StmtNode*)$7->get_ast_node()
+			node_id ifNode = ast.make_if(
+				$3->get_ast_node(),
+				$5->get_ast_node(),
+				$7->get_ast_node()
 			);
 			$$->set_ast_node(ifNode);
+			ast.begin_region();
 	  }
-	  | WHILE LPAREN expression RPAREN statement
+	  | WHILE expr_region LPAREN expression RPAREN statement
 	  {
 	    	outlog<<"At line no: "<<lines<<" statement : WHILE LPAREN expression RPAREN statement "<<endl<<endl;
-			outlog<<"while("<<$3->getname()<<")\n"<<$5->getname()<<endl<<endl;
+			outlog<<"while("<<$4->getname()<<")\n"<<$6->getname()<<endl<<endl;
 			
-			$$ = new symbol_info("while("+$3->getname()+")\n"+$5->getname(),"stmnt");
+			$$ = new symbol_info("while("+$4->getname()+")\n"+$6->getname(),"stmnt");
 			
 			// Create AST node for while loop
-			WhileNode* whileNode = new WhileNode(
-				(ExprNode*)$3->get_ast_node(),
-				(StmtNode*)$5->get_ast_node()
+			node_id whileNode = ast.make_while(
+				$4->get_ast_node(),
+				$6->get_ast_node()
 			);
 			$$->set_ast_node(whileNode);
+			ast.begin_region();
 	  }
 	  | PRINTLN LPAREN id_name RPAREN SEMICOLON
 	  {
 	    	outlog<<"At line no: "<<lines<<" statement : PRINTLN LPAREN ID RPAREN SEMICOLON "<<endl<<endl;
 			outlog<<"printf("<<$3->getname()<<");"<<endl<<endl; 
 			
+			if(xref) xref->use(symtbl->Lookup_in_table($3->getname()), lines);
+			
 			if(symtbl->Lookup_in_table($3->getname()) == NULL)
 			{
 				outerror<<"At line no: "<<lines<<" Undeclared variable "<<$3->getname()<<endl<<endl;
@@ -629,10 +648,10 @@ statement : var_declaration
 			
 			// Could add a PrintNode to AST if needed
 			// For now, create a basic expression statement
-			VarNode* var = new VarNode($3->getname(), 
+			node_id var = ast.make_var($3->getname(), 
 			                         symtbl->Lookup_in_table($3->getname()) ? 
 			                         symtbl->Lookup_in_table($3->getname())->getvartype() : "error");
-			ExprStmtNode* printNode = new ExprStmtNode(var);
+			node_id printNode = ast.make_expr_stmt(var);
 			$$->set_ast_node(printNode);
 	  }
 	  | RETURN expression SEMICOLON
@@ -643,11 +662,19 @@ statement : var_declaration
 			$$ = new symbol_info("return "+$2->getname()+";","stmnt");
 			
 			// Create AST node for return statement
-			ReturnNode* returnNode = new ReturnNode((ExprNode*)$2->get_ast_node());
+			node_id returnNode = ast.make_return($2->get_ast_node());
 			$$->set_ast_node(returnNode);
 	  }
 	  ;
 	  
+// Start a new straight-line region for the expression DAG: the code that follows
+// is reached along a loop back edge, so it must not share nodes with what came before
+expr_region :
+			{
+				ast.begin_region();
+			}
+			;
+
 expression_statement : SEMICOLON
 			{
 				outlog<<"At line no: "<<lines<<" expression_statement : SEMICOLON "<<endl<<endl;
@@ -656,7 +683,7 @@ expression_statement : SEMICOLON
 				$$ = new symbol_info(";","expr_stmt");
 				
 				// Create empty expression statement
-				ExprStmtNode* exprStmt = new ExprStmtNode(nullptr);
+				node_id exprStmt = ast.make_expr_stmt(NO_NODE);
 				$$->set_ast_node(exprStmt);
 	        }			
 			| expression SEMICOLON 
@@ -667,7 +694,7 @@ expression_statement : SEMICOLON
 				$$ = new symbol_info($1->getname()+";","expr_stmt");
 				
 				// Create expression statement from expression
-				ExprStmtNode* exprStmt = new ExprStmtNode((ExprNode*)$1->get_ast_node());
+				node_id exprStmt = ast.make_expr_stmt($1->get_ast_node());
 				$$->set_ast_node(exprStmt);
 	        }
 			;
@@ -679,6 +706,8 @@ variable : id_name
 			
 		$$ = new symbol_info($1->getname(),"varbl");
 		
+		if(xref) xref->use(symtbl->Lookup_in_table($1->getname()), lines);
+		
 		if(symtbl->Lookup_in_table($1->getname()) == NULL)
 		{
 			outerror<<"At line no: "<<lines<<" Undeclared variable "<<$1->getname()<<endl<<endl;
@@ -714,7 +743,7 @@ variable : id_name
 		else $$->setvartype((symtbl->Lookup_in_table($1->getname()))->getvartype());  //set variable type as id type
 		
 		// Create AST node for variable
-		VarNode* varNode = new VarNode($1->getname(), $$->getvartype());
+		node_id varNode = ast.make_var($1->getname(), $$->getvartype());
 		$$->set_ast_node(varNode);
 	 }	
 	 | id_name LTHIRD expression RTHIRD 
@@ -724,6 +753,8 @@ variable : id_name
 		
 		$$ = new symbol_info($1->getname()+"["+$3->getname()+"]","varbl");
 		
+		if(xref) xref->use(symtbl->Lookup_in_table($1->getname()), lines);
+		
 		if(symtbl->Lookup_in_table($1->getname()) == NULL)
 		{
 			outerror<<"At line no: "<<lines<<" Undeclared variable "<<$1->getname()<<endl<<endl;
@@ -754,7 +785,7 @@ variable : id_name
 		}
 		
 		// Create AST node for array access
-		VarNode* varNode = new VarNode($1->getname(), $$->getvartype(), (ExprNode*)$3->get_ast_node());
+		node_id varNode = ast.make_var($1->getname(), $$->getvartype(), $3->get_ast_node());
 		$$->set_ast_node(varNode);
 	 }
 	 ;
@@ -799,9 +830,9 @@ expression : logic_expression //expr can be void
 			}
 			
 			// Create AST node for assignment
-			AssignNode* assignNode = new AssignNode(
-				(VarNode*)$1->get_ast_node(),
-				(ExprNode*)$3->get_ast_node(),
+			node_id assignNode = ast.make_assign(
+				$1->get_ast_node(),
+				$3->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(assignNode);
@@ -842,10 +873,10 @@ logic_expression : rel_expression //lgc_expr can be void
 			}
 			
 			// Create AST node for logical operation
-			BinaryOpNode* logicNode = new BinaryOpNode(
+			node_id logicNode = ast.make_binary_op(
 				$2->getname(),
-				(ExprNode*)$1->get_ast_node(),
-				(ExprNode*)$3->get_ast_node(),
+				$1->get_ast_node(),
+				$3->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(logicNode);
@@ -886,10 +917,10 @@ rel_expression	: simple_expression //rel_expr can be void
 			}
 			
 			// Create AST node for relational operation
-			BinaryOpNode* relNode = new BinaryOpNode(
+			node_id relNode = ast.make_binary_op(
 				$2->getname(),
-				(ExprNode*)$1->get_ast_node(),
-				(ExprNode*)$3->get_ast_node(),
+				$1->get_ast_node(),
+				$3->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(relNode);
@@ -936,10 +967,10 @@ simple_expression : term //simp_expr can be void
 			}
 			
 			// Create AST node for addition/subtraction
-			BinaryOpNode* addopNode = new BinaryOpNode(
+			node_id addopNode = ast.make_binary_op(
 				$2->getname(),
-				(ExprNode*)$1->get_ast_node(),
-				(ExprNode*)$3->get_ast_node(),
+				$1->get_ast_node(),
+				$3->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(addopNode);
@@ -1021,10 +1052,10 @@ term :	unary_expression //term can be void because of un_expr->factor
 			}
 			
 			// Create AST node for multiplication/division/modulus
-			BinaryOpNode* mulopNode = new BinaryOpNode(
+			node_id mulopNode = ast.make_binary_op(
 				$2->getname(),
-				(ExprNode*)$1->get_ast_node(),
-				(ExprNode*)$3->get_ast_node(),
+				$1->get_ast_node(),
+				$3->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(mulopNode);
@@ -1049,9 +1080,9 @@ unary_expression : ADDOP unary_expression  // un_expr can be void because of fac
 			}
 			
 			// Create AST node for unary plus/minus
-			UnaryOpNode* unaryNode = new UnaryOpNode(
+			node_id unaryNode = ast.make_unary_op(
 				$1->getname(),
-				(ExprNode*)$2->get_ast_node(),
+				$2->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(unaryNode);
@@ -1074,9 +1105,9 @@ unary_expression : ADDOP unary_expression  // un_expr can be void because of fac
 			}
 			
 			// Create AST node for logical NOT
-			UnaryOpNode* notNode = new UnaryOpNode(
+			node_id notNode = ast.make_unary_op(
 				"!",
-				(ExprNode*)$2->get_ast_node(),
+				$2->get_ast_node(),
 				$$->getvartype()
 			);
 			$$->set_ast_node(notNode);
@@ -1113,6 +1144,8 @@ factor	: variable  // factor can be void
 	
 	    int flag = 0;
 	
+	    if(xref) xref->use(symtbl->Lookup_in_table($1->getname()), lines);
+	
 	    // Type checking (existing code)
 	    if(symtbl->Lookup_in_table($1->getname())==NULL) //undeclared function
 	    {
@@ -1130,7 +1163,7 @@ factor	: variable  // factor can be void
 	        }
 	        else if((symtbl->Lookup_in_table($1->getname()))->getidtype()=="func_def")
 	        {
-	            vector<string> templist = (symtbl->Lookup_in_table($1->getname()))->getparamlist();
+	            const vector<string>& templist = (symtbl->Lookup_in_table($1->getname()))->getparamlist();
 	
 	            if(arglist.size()!=templist.size()) //number of prameters don't match
 	            {
@@ -1160,18 +1193,8 @@ factor	: variable  // factor can be void
 	    }
 	
 	    // Create function call node
-	    FuncCallNode* funcCall = new FuncCallNode($1->getname(), $$->getvartype());
-	
-	    // Get arguments from the ArgumentsNode if it exists
-	    if ($3->get_ast_node()) {
-	        ArgumentsNode* argsNode = dynamic_cast<ArgumentsNode*>($3->get_ast_node());
-	        if (argsNode) {
-	            // Add each argument to the function call
-	            for (auto arg : argsNode->get_arguments()) {
-	                funcCall->add_argument(arg);
-	            }
-	        }
-	    }
+	    // with the arguments collected in the ARGUMENTS node, if it exists
+	    node_id funcCall = ast.make_func_call($1->getname(), $$->getvartype(), $3->get_ast_node());
 	
 	    $$->set_ast_node(funcCall);
 	
@@ -1195,7 +1218,7 @@ factor	: variable  // factor can be void
 		$$->setvartype("int");
 		
 		// Create AST node for integer constant
-		ConstNode* intNode = new ConstNode($1->getname(), "int");
+		node_id intNode = ast.make_const($1->getname(), "int");
 		$$->set_ast_node(intNode);
 	}
 	| CONST_FLOAT
@@ -1207,7 +1230,7 @@ factor	: variable  // factor can be void
 		$$->setvartype("float");
 		
 		// Create AST node for float constant
-		ConstNode* floatNode = new ConstNode($1->getname(), "float");
+		node_id floatNode = ast.make_const($1->getname(), "float");
 		$$->set_ast_node(floatNode);
 	}
 	| variable INCOP 
@@ -1220,10 +1243,10 @@ factor	: variable  // factor can be void
 		
 		// Create AST nodes for increment
 		// For x++, equivalent to (x = x + 1)
-		VarNode* varNode = (VarNode*)$1->get_ast_node();
-		ConstNode* oneNode = new ConstNode("1", "int");
-		BinaryOpNode* addNode = new BinaryOpNode("+", varNode, oneNode, $1->getvartype());
-		AssignNode* assignNode = new AssignNode(varNode, addNode, $1->getvartype());
+		node_id varNode = $1->get_ast_node();
+		node_id oneNode = ast.make_const("1", "int");
+		node_id addNode = ast.make_binary_op("+", varNode, oneNode, $1->getvartype());
+		node_id assignNode = ast.make_assign(varNode, addNode, $1->getvartype());
 		$$->set_ast_node(assignNode);
 	}
 	| variable DECOP
@@ -1236,10 +1259,10 @@ factor	: variable  // factor can be void
 		
 		// Create AST nodes for decrement
 		// For x--, equivalent to (x = x - 1)
-		VarNode* varNode = (VarNode*)$1->get_ast_node();
-		ConstNode* oneNode = new ConstNode("1", "int");
-		BinaryOpNode* subNode = new BinaryOpNode("-", varNode, oneNode, $1->getvartype());
-		AssignNode* assignNode = new AssignNode(varNode, subNode, $1->getvartype());
+		node_id varNode = $1->get_ast_node();
+		node_id oneNode = ast.make_const("1", "int");
+		node_id subNode = ast.make_binary_op("-", varNode, oneNode, $1->getvartype());
+		node_id assignNode = ast.make_assign(varNode, subNode, $1->getvartype());
 		$$->set_ast_node(assignNode);
 	}
 	;
@@ -1258,8 +1281,7 @@ argument_list : arguments
                         
                     $$ = new symbol_info("","arg_list");
                     // Create empty arguments node
-                    ArgumentsNode* args = new ArgumentsNode();
-                    $$->set_ast_node(args);
+                    $$->set_ast_node(ast.make_arguments());
               }
               ;
     
@@ -1271,17 +1293,13 @@ arguments : arguments COMMA logic_expression
                 $$ = new symbol_info($1->getname()+","+$3->getname(),"arg");
                 
                 // Get existing arguments node or create new one
-                ArgumentsNode* args;
-                if ($1->get_ast_node()) {
-                    args = dynamic_cast<ArgumentsNode*>($1->get_ast_node());
-                } else {
-                    args = new ArgumentsNode();
+                node_id args = $1->get_ast_node();
+                if (!args) {
+                    args = ast.make_arguments();
                 }
                 
                 // Add the new argument
-                if ($3->get_ast_node()) {
-                    args->add_argument(dynamic_cast<ExprNode*>($3->get_ast_node()));
-                }
+                ast.add_argument(args, $3->get_ast_node());
                 
                 $$->set_ast_node(args);
                 arglist.push_back($3->getvartype());
@@ -1294,10 +1312,8 @@ arguments : arguments COMMA logic_expression
                 $$ = new symbol_info($1->getname(),"arg");
                 
                 // Create a new arguments node with single argument
-                ArgumentsNode* args = new ArgumentsNode();
-                if ($1->get_ast_node()) {  // FIXED: Changed from $3 to $1
-                    args->add_argument(dynamic_cast<ExprNode*>($1->get_ast_node()));
-                }
+                node_id args = ast.make_arguments();
+                ast.add_argument(args, $1->get_ast_node());
                 
                 $$->set_ast_node(args);
                 arglist.push_back($1->getvartype());
@@ -1307,14 +1323,304 @@ arguments : arguments COMMA logic_expression
 
 %%
 
+struct compile_options
+{
+	string input_file, interface_out;
+	vector<string> interface_in;
+	vector<string> skip_passes;
+	int opt_level = 0;
+	bool time_passes = false;
+	bool incremental = false;
+	TacFormat tac_format = TacFormat::TEXT;
+	string tac_cache;
+	string xref_out;
+	string xref_query_index, xref_query_name;
+};
+
+// Declares functions exported by other translation units in the global scope
+set<string> import_interfaces(const compile_options &opts)
+{
+	set<string> imported_funcs;
+	for(auto &path : opts.interface_in)
+	{
+		vector<string> imported, conflicts;
+		string reason;
+		int n = import_interface(symtbl, path, imported, conflicts, reason);
+		if(n < 0)
+		{
+			outerror<<"Could not import interface: "<<reason<<endl<<endl;
+			outlog<<"Could not import interface: "<<reason<<endl<<endl;
+			errors++;
+			continue;
+		}
+		for(auto &name : conflicts)
+		{
+			outerror<<"Conflicting declaration of function "<<name<<" in interface "<<path<<endl<<endl;
+			outlog<<"Conflicting declaration of function "<<name<<" in interface "<<path<<endl<<endl;
+			errors++;
+		}
+		imported_funcs.insert(imported.begin(), imported.end());
+		if(xref)
+		{
+			for(auto &name : imported) xref->define(symtbl->Lookup_in_table(name), XREF_IMPORTED_FUNC, 0, symtbl->getID());
+		}
+		outlog<<"Imported "<<n<<" functions from interface "<<path<<endl<<endl;
+	}
+	return imported_funcs;
+}
+
+// Second pass: run the registered passes over the AST, code generation among them
+void generate_code(const compile_options &opts)
+{
+	// Only proceed to second pass if no errors
+	if (errors == 0 && ast_root) {
+		cout << "==== Pass 2: Generating Three-Address Code from AST ====" << endl;
+		outlog << endl << "==== Pass 2: Generating Three-Address Code from AST ====" << endl;
+		
+		outlog << "Generating Three-Address Code..." << endl;
+		PassManager passes;
+		passes.add(make_unique<ASTVerifierPass>());
+		passes.add(make_unique<ConstantFoldingPass>());
+		passes.add(make_unique<SethiUllmanPass>());
+		passes.add(make_unique<FrameLayoutPass>());
+		passes.add(make_unique<ThreeAddrCodePass>(opts.tac_cache));
+		passes.add(make_unique<InlinePass>());
+		passes.add(make_unique<CfgPass>());
+		passes.add(make_unique<LvnPass>());
+		passes.add(make_unique<CopyPropagationPass>());
+		passes.add(make_unique<DeadCodePass>());
+		passes.add(make_unique<LicmPass>());
+		passes.add(make_unique<StrengthReductionPass>());
+		passes.add(make_unique<TempReusePass>());
+		passes.add(make_unique<TacPrintPass>(opts.tac_format));
+		for(auto &name : opts.skip_passes) passes.disable(name);
+		
+		TacProgram tac;
+		PassContext ctx = {ast, ast_root, tac, outlog, outerror, outcode, opts.opt_level};
+		string reason;
+		if(passes.run(ctx, reason))
+		{
+			outlog << "Three-Address Code Generation Complete" << endl;
+			if(opts.tac_format == TacFormat::TEXT) cout << "Three-Address Code Generation Complete. Output written to code.txt" << endl;
+			else if(opts.tac_format == TacFormat::BINARY) cout << "Three-Address Code Generation Complete. Output written to code.bin" << endl;
+			else cout << "Three-Address Code Generation Complete. Instruction counts written to log.txt" << endl;
+		}
+		else
+		{
+			outerror<<"Code generation stopped: "<<reason<<endl<<endl;
+			outlog<<"Code generation stopped: "<<reason<<endl<<endl;
+			errors++;
+		}
+		if(opts.time_passes)
+		{
+			cout << "AST nodes: " << ast.size() << endl;
+			passes.print_timings(cout);
+		}
+	} else {
+		cout << "Three-Address Code generation skipped due to errors" << endl;
+		outlog << endl << "Three-Address Code generation skipped due to errors" << endl;
+		outcode << "// Three-Address Code generation failed due to errors" << endl;
+	}
+}
+
+// Export the global function signatures for separately compiled units
+void write_interface(const compile_options &opts, const set<string> &imported_funcs)
+{
+	if(opts.interface_out.empty()) return;
+	string reason;
+	if(errors != 0)
+	{
+		outlog<<endl<<"Interface "<<opts.interface_out<<" not written due to errors"<<endl;
+	}
+	else if(export_interface(symtbl->get_global_scope(), opts.interface_out, imported_funcs, reason))
+	{
+		outlog<<endl<<"Interface written to "<<opts.interface_out<<endl;
+	}
+	else
+	{
+		outerror<<"Could not write interface: "<<reason<<endl<<endl;
+		outlog<<"Could not write interface: "<<reason<<endl<<endl;
+		errors++;
+	}
+}
+
+// Write the cross-reference index built during parsing
+void write_xref(const compile_options &opts)
+{
+	if(!xref) return;
+	string reason;
+	if(xref->write(opts.xref_out, reason))
+	{
+		outlog<<endl<<"Cross-reference index written to "<<opts.xref_out<<": "<<xref->num_symbols()<<" symbols, "
+			<<xref->num_uses()<<" uses"<<endl;
+	}
+	else
+	{
+		outerror<<"Could not write cross-reference index: "<<reason<<endl<<endl;
+		outlog<<"Could not write cross-reference index: "<<reason<<endl<<endl;
+		errors++;
+	}
+}
+
+// Answers "where is name defined and used" from an index, without compiling
+int query_xref(const compile_options &opts)
+{
+	XrefIndex index;
+	string reason;
+	if(!index.open(opts.xref_query_index, reason))
+	{
+		cout<<"error: "<<reason<<endl;
+		return 1;
+	}
+	auto found = index.find(opts.xref_query_name);
+	if(found.first == found.second) cout<<opts.xref_query_name<<": not found"<<endl;
+	for(auto s = found.first; s != found.second; ++s) index.print(*s, cout);
+	return 0;
+}
+
+// Parses one top-level unit on its own, as if it were the whole program,
+// keeping its error messages and dropping the parser trace
+ParsedUnit parse_unit(const string &text, int line)
+{
+	stringbuf error_text, trace;
+	streambuf *error_file = outerror.basic_ios<char>::rdbuf(&error_text);
+	streambuf *log_file = outlog.basic_ios<char>::rdbuf(&trace);
+	int errors_before = errors;
+	
+	varlist = "";
+	paramlist.clear();
+	paramname.clear();
+	arglist.clear();
+	is_func = 0;
+	ret_type = func_name = func_ret_type = "";
+	
+	FILE *in = fmemopen((void *)text.data(), text.size(), "r");
+	yyin = in;
+	yyrestart(yyin);
+	lines = line;
+	ast_root = NO_NODE;
+	ast.begin_region();
+	parsing_unit = true;
+	yyparse();
+	parsing_unit = false;
+	fclose(in);
+	yyin = NULL;
+	
+	outerror.basic_ios<char>::rdbuf(error_file);
+	outlog.basic_ios<char>::rdbuf(log_file);
+	
+	ParsedUnit unit;
+	if(ast_root) ast.for_each(ast.program(ast_root).units, [&](node_id u) { if(!unit.node) unit.node = u; });
+	unit.errors = errors - errors_before;
+	unit.messages = error_text.str();
+	return unit;
+}
+
+// Editor mode: reads one file name per line from stdin and compiles each
+// version of the file incrementally, writing the usual output files and one
+// status line per version to stdout
+int run_incremental(const compile_options &opts)
+{
+	IncrementalSession session;
+	string path;
+	while(getline(cin, path))
+	{
+		if(path.empty()) continue;
+		ifstream in(path, ios::binary);
+		if(!in)
+		{
+			cout<<"error: cannot open "<<path<<endl;
+			continue;
+		}
+		string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+		auto start = chrono::steady_clock::now();
+		
+		// the console belongs to the editor; progress messages go nowhere
+		stringbuf console;
+		streambuf *stdout_buf = cout.rdbuf(&console);
+		
+		outlog.open("log.txt", ios::trunc);
+		outerror.open("error.txt", ios::trunc);
+		outcode.open("code.txt", ios::trunc);
+		errors = 0;
+		delete symtbl;
+		symtbl = new symbol_table();
+		symtbl->enter_scope(outlog);
+		set<string> imported_funcs = import_interfaces(opts);
+		int import_errors = errors;
+		
+		IncrementalSession::Result result = session.update(text, ast, symtbl, parse_unit);
+		outerror<<result.messages;
+		outlog<<result.messages;
+		outlog<<"Reparsed "<<result.reparsed<<" of "<<result.units<<" units"<<endl;
+		errors = import_errors + result.errors; // reused units count their errors again
+		ast_root = result.program;
+		lines = result.lines;
+		
+		generate_code(opts);
+		write_interface(opts, imported_funcs);
+		
+		outlog<<endl<<"Total lines: "<<lines<<endl;
+		outlog<<"Total errors: "<<errors<<endl;
+		outerror<<"Total errors: "<<errors<<endl;
+		outlog.close();
+		outerror.close();
+		outcode.close();
+		
+		cout.rdbuf(stdout_buf);
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		cout<<"compiled "<<path<<": "<<errors<<" errors, reparsed "<<result.reparsed<<" of "<<result.units
+			<<" units in "<<fixed<<setprecision(3)<<ms<<" ms"<<endl;
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[])
 {
-	if(argc != 2) 
+	compile_options opts;
+	
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-import" && i+1 < argc) opts.interface_in.push_back(argv[++i]);
+		else if(arg == "-emit-interface" && i+1 < argc) opts.interface_out = argv[++i];
+		else if(arg == "-skip-pass" && i+1 < argc) opts.skip_passes.push_back(argv[++i]);
+		else if(arg == "-time-passes") opts.time_passes = true;
+		else if(arg == "-expr-dag") ast.set_hash_consing(true);
+		else if(arg == "-incremental") opts.incremental = true;
+		else if(arg == "-tac-cache" && i+1 < argc) opts.tac_cache = argv[++i];
+		else if(arg == "-xref" && i+1 < argc) opts.xref_out = argv[++i];
+		else if(arg == "-xref-query" && i+2 < argc)
+		{
+			opts.xref_query_index = argv[++i];
+			opts.xref_query_name = argv[++i];
+		}
+		else if(arg == "-emit" && i+1 < argc)
+		{
+			string format = argv[++i];
+			if(format == "binary") opts.tac_format = TacFormat::BINARY;
+			else if(format == "count") opts.tac_format = TacFormat::COUNT;
+			else opts.tac_format = TacFormat::TEXT;
+		}
+		else if(arg.size() == 3 && arg[0] == '-' && arg[1] == 'O' && isdigit(arg[2])) opts.opt_level = arg[2] - '0';
+		else opts.input_file = arg;
+	}
+	
+	if(!opts.xref_query_index.empty()) return query_xref(opts);
+	// reused units are not parsed again, so incremental mode cannot see their uses
+	if(!opts.xref_out.empty() && opts.incremental) cout<<"-xref is ignored with -incremental"<<endl;
+	else if(!opts.xref_out.empty()) xref = new XrefBuilder();
+	if(opts.incremental) return run_incremental(opts);
+	
+	if(opts.input_file.empty()) 
 	{
 		cout<<"Please input file name"<<endl;
+		cout<<"Usage: "<<argv[0]<<" [-O0|-O1|-O2] [-skip-pass name]... [-time-passes] [-expr-dag] [-emit text|binary|count] [-tac-cache file] [-xref file] [-import file.tif]... [-emit-interface file.tif] input.c"<<endl;
+		cout<<"       "<<argv[0]<<" -incremental [options]   (file names to compile are read from stdin)"<<endl;
+		cout<<"       "<<argv[0]<<" -xref-query file name     (definition and uses of name in an index)"<<endl;
 		return 0;
 	}
-	yyin = fopen(argv[1], "r");
+	yyin = fopen(opts.input_file.c_str(), "r");
 	outlog.open("log.txt", ios::trunc);
 	outerror.open("error.txt", ios::trunc);
 	outcode.open("code.txt", ios::trunc);
@@ -1330,28 +1636,24 @@ int main(int argc, char *argv[])
 	outlog << "==== Pass 1: Parsing input and building AST ====" << endl;
 	
 	symtbl->enter_scope(outlog);
+	
+	set<string> imported_funcs = import_interfaces(opts);
+	
 	yyparse();
 	
 	outlog << endl << "Symbol Table after first pass:" << endl;
 	symtbl->Print_all_scope(outlog);
 	
-	// Only proceed to second pass if no errors
-	if (errors == 0 && ast_root) {
-		cout << "==== Pass 2: Generating Three-Address Code from AST ====" << endl;
-		outlog << endl << "==== Pass 2: Generating Three-Address Code from AST ====" << endl;
-		
-		// Generate three-address code (second pass)
-		outlog << "Generating Three-Address Code..." << endl;
-		ThreeAddrCodeGenerator tacGen(ast_root, outcode);
-		tacGen.generate();
-		
-		outlog << "Three-Address Code Generation Complete" << endl;
-		cout << "Three-Address Code Generation Complete. Output written to code.txt" << endl;
-	} else {
-		cout << "Three-Address Code generation skipped due to errors" << endl;
-		outlog << endl << "Three-Address Code generation skipped due to errors" << endl;
-		outcode << "// Three-Address Code generation failed due to errors" << endl;
-	}
+	generate_code(opts);
+	write_interface(opts, imported_funcs);
+	write_xref(opts);
+	
+#ifdef SYMTAB_STATS
+	// the global scope is never exited, record it before dumping the counters
+	symtab_counters().scope_exit(symtbl->get_global_scope()->getID(), symtbl->get_global_scope()->binding_depths());
+	symtab_counters().write_json("symtab_stats.json");
+	cout<<"Symbol table statistics written to symtab_stats.json"<<endl;
+#endif
 	
 	outlog<<endl<<"Total lines: "<<lines<<endl;
 	outlog<<"Total errors: "<<errors<<endl;
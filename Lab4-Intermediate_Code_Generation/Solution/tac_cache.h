@@ -0,0 +1,369 @@
+#ifndef TAC_CACHE_H
+#define TAC_CACHE_H
+
+#include "ast.h"
+#include "emitter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// On-disk cache of the three-address code of each function.
+//
+// A function is keyed by a hash of its AST after the optimization passes: node
+// kinds, types, flags, names, operators, constants and shape. Types resolved
+// from the global scope (the element type of a global array, say) are node
+// types, so a change to a global declaration the function uses changes the key.
+// The code is stored as tac_records numbered from t0 and L0 and is replayed
+// into the real emitter with temps and labels rebased onto the current
+// counters, so a hit and a miss produce the same output.
+//
+// Layout (native byte order, recorded in the header; a cache written with the
+// other order is ignored):
+//
+//   tacc_header
+//   tacc_entry [num_entries]   sorted by key
+//   tac_record [num_records]   records of entry k are [first_record, first_record+num_records)
+//   char       [strtab_size]   strings of entry k are [str_off, str_off+str_size)
+//
+// The file holds the functions of the last run and is rewritten after each one.
+
+const char TACC_MAGIC[4] = {'T', 'A', 'C', 'C'};
+const uint16_t TACC_VERSION = 4;
+const uint16_t TACC_BYTE_ORDER = 0x0102;
+
+struct tacc_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t num_entries;
+    uint32_t num_records;
+    uint32_t strtab_size;
+};
+
+struct tacc_entry {
+    uint64_t key;
+    uint32_t first_record;
+    uint32_t num_records;
+    uint32_t str_off;
+    uint32_t str_size;
+    uint32_t temps;
+    uint32_t labels;
+};
+
+static_assert(sizeof(tacc_header) == 20, "TAC cache header layout changed");
+static_assert(sizeof(tacc_entry) == 32, "TAC cache entry layout changed");
+
+// Marks an empty line; only appears in the cache
+const uint8_t TACC_BLANK = (uint8_t)TacOp::COUNT;
+
+// Records code in memory, strings in a table of its own. Only generated code is
+// recorded, whose operands are temps but for the source of a copy.
+class TacRecorder {
+private:
+    void add(TacOp op, string_view s, int32_t dst, int32_t a, int32_t b) {
+        tac_record r = {};
+        r.op = (uint8_t)op;
+        r.str_off = strtab.size();
+        r.str_len = s.size();
+        strtab.append(s);
+        r.dst = dst;
+        r.a = a;
+        r.b = b;
+        records.push_back(r);
+    }
+
+public:
+    vector<tac_record> records;
+    string strtab;
+
+    void begin() {}
+    void end() {}
+
+    void comment(string_view text) { add(TacOp::COMMENT, text, -1, -1, -1); }
+    void blank() { add(TacOp::COMMENT, {}, -1, -1, -1); records.back().op = TACC_BLANK; }
+
+    void copy(Temp dst, Value src) { add(TacOp::COPY, src.text, dst.n, -1, -1); }
+    void load(Value dst, string_view array, Value offset) { add(TacOp::LOAD, array, dst.temp.n, offset.temp.n, -1); }
+    void store(string_view array, Value offset, Value src) { add(TacOp::STORE, array, -1, offset.temp.n, src.temp.n); }
+    void assign(string_view name, Value src) { add(TacOp::ASSIGN, name, -1, src.temp.n, -1); }
+    void binary(Value dst, Value a, string_view op, Value b) { add(TacOp::BINARY, op, dst.temp.n, a.temp.n, b.temp.n); }
+    void unary(Value dst, string_view op, Value a) { add(TacOp::UNARY, op, dst.temp.n, a.temp.n, -1); }
+    void param(Value a) { add(TacOp::PARAM, {}, -1, a.temp.n, -1); }
+    void call(Value dst, string_view func, int nargs) { add(TacOp::CALL, func, dst.temp.n, -1, nargs); }
+    void cond_jump(Value a, int l) { add(TacOp::COND_JUMP, {}, l, a.temp.n, -1); }
+    void branch(Value a, string_view op, Value b, int l) { add(TacOp::BRANCH, op, l, a.temp.n, b.temp.n); }
+    void jump(int l) { add(TacOp::JUMP, {}, l, -1, -1); }
+    void label(int l) { add(TacOp::LABEL, {}, l, -1, -1); }
+    void ret(Value a) { add(TacOp::RETURN, {}, -1, a.temp.n, -1); }
+};
+
+class TacCache {
+public:
+    // One function's code, either in the mapped file or owned by the cache
+    struct Function {
+        uint64_t key;
+        const tac_record *records;
+        uint32_t num_records;
+        const char *strtab;
+        uint32_t str_size;
+        uint32_t temps, labels;
+    };
+
+private:
+    void *map = MAP_FAILED;
+    size_t map_size = 0;
+    const tacc_entry *entries = nullptr;
+    uint32_t num_entries = 0;
+    const tac_record *all_records = nullptr;
+    const char *all_strings = nullptr;
+
+    deque<TacRecorder> owned; // code generated in this run
+    vector<Function> used;    // what the next cache file will hold
+
+    static uint64_t mix(uint64_t h, uint64_t v) {
+        h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h * 0xff51afd7ed558ccdULL;
+    }
+
+    // Ids differ between runs, so strings are hashed by content, once per run
+    vector<uint64_t> str_hashes, type_hashes;
+
+    static uint64_t hash_string(const string &s) {
+        uint64_t f = 0xcbf29ce484222325ULL; // FNV-1a
+        for (unsigned char c : s) f = (f ^ c) * 0x100000001b3ULL;
+        return mix(s.size(), f) | 1; // 0 marks a string not hashed yet
+    }
+
+    static uint64_t memo(vector<uint64_t> &hashes, uint32_t id, const string &s) {
+        if (id >= hashes.size()) hashes.resize(id + 1);
+        if (!hashes[id]) hashes[id] = hash_string(s);
+        return hashes[id];
+    }
+
+    uint64_t str(const ASTArena &ast, str_id id) { return memo(str_hashes, id, ast.str(id)); }
+
+    uint64_t hash(const ASTArena &ast, node_id id) {
+        uint64_t h = mix(0, (uint64_t)ast.kind(id));
+        if (!id) return h;
+        h = mix(h, memo(type_hashes, ast.type_id(id), ast.get_type(id)));
+        h = mix(h, (uint64_t)ast.has_flag(id, RIGHT_FIRST));
+        auto child = [&](node_id c) { h = mix(h, hash(ast, c)); };
+        switch (ast.kind(id)) {
+        case NodeKind::VAR: h = mix(h, str(ast, ast.var(id).name)); child(ast.var(id).index); break;
+        case NodeKind::CONST: h = mix(h, str(ast, ast.constant(id).value)); break;
+        case NodeKind::BINARY_OP: {
+            const BinaryOpNode &b = ast.binary_op(id);
+            h = mix(h, str(ast, b.op));
+            child(b.left);
+            child(b.right);
+            break;
+        }
+        case NodeKind::UNARY_OP: h = mix(h, str(ast, ast.unary_op(id).op)); child(ast.unary_op(id).expr); break;
+        case NodeKind::FUNC_CALL: {
+            const FuncCallNode &call = ast.func_call(id);
+            h = mix(mix(h, str(ast, call.func_name)), call.num_args);
+            for (uint32_t i = 0; i < call.num_args; i++) child(ast.call_arg(call, i));
+            break;
+        }
+        case NodeKind::BLOCK:
+            h = mix(h, ast.block(id).statements.count);
+            ast.for_each(ast.block(id).statements, child);
+            break;
+        case NodeKind::IF: {
+            const IfNode &s = ast.if_stmt(id);
+            child(s.condition);
+            child(s.then_block);
+            child(s.else_block);
+            break;
+        }
+        case NodeKind::FOR: {
+            const ForNode &s = ast.for_stmt(id);
+            child(s.init);
+            child(s.condition);
+            child(s.update);
+            child(s.body);
+            break;
+        }
+        case NodeKind::DECL: {
+            const DeclNode &d = ast.decl(id);
+            h = mix(mix(h, str(ast, d.type)), d.num_vars);
+            for (uint32_t i = 0; i < d.num_vars; i++) {
+                h = mix(mix(h, str(ast, ast.decl_var(d, i).name)), (uint64_t)ast.decl_var(d, i).array_size);
+            }
+            break;
+        }
+        case NodeKind::FUNC_DECL: {
+            const FuncDeclNode &f = ast.func_decl(id);
+            h = mix(mix(mix(h, str(ast, f.return_type)), str(ast, f.name)), f.num_params);
+            for (uint32_t i = 0; i < f.num_params; i++) {
+                h = mix(mix(h, str(ast, ast.param(f, i).type)), str(ast, ast.param(f, i).name));
+            }
+            child(f.body);
+            break;
+        }
+        default:
+            // the remaining kinds have either only required children or a single optional one
+            ast.for_each_child(id, child);
+            break;
+        }
+        return h;
+    }
+
+public:
+    int hits = 0, misses = 0;
+
+    TacCache() {}
+    TacCache(const TacCache &) = delete;
+    TacCache &operator=(const TacCache &) = delete;
+    ~TacCache() {
+        if (map != MAP_FAILED) munmap(map, map_size);
+    }
+
+    // Maps an existing cache file. A missing or unusable file is an empty cache.
+    void load(const string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)sizeof(tacc_header)) {
+            close(fd);
+            return;
+        }
+        map_size = sb.st_size;
+        map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return;
+
+        const char *base = (const char *)map;
+        tacc_header h;
+        memcpy(&h, base, sizeof(h));
+        uint64_t expected = sizeof(tacc_header) + (uint64_t)h.num_entries * sizeof(tacc_entry) +
+                            (uint64_t)h.num_records * sizeof(tac_record) + h.strtab_size;
+        if (memcmp(h.magic, TACC_MAGIC, sizeof(h.magic)) != 0 || h.version != TACC_VERSION ||
+            h.byte_order != TACC_BYTE_ORDER || expected != map_size) {
+            return;
+        }
+        const tacc_entry *e = (const tacc_entry *)(base + sizeof(tacc_header));
+        const tac_record *r = (const tac_record *)(e + h.num_entries);
+        for (uint32_t k = 0; k < h.num_entries; k++) {
+            if ((uint64_t)e[k].first_record + e[k].num_records > h.num_records ||
+                (uint64_t)e[k].str_off + e[k].str_size > h.strtab_size) {
+                return;
+            }
+        }
+        entries = e;
+        num_entries = h.num_entries;
+        all_records = r;
+        all_strings = (const char *)(r + h.num_records);
+    }
+
+    uint64_t key(const ASTArena &ast, node_id func) { return mix(hash(ast, func), TACC_VERSION); }
+
+    // Looks up the cached code for key
+    bool find(uint64_t key, Function &f) {
+        const tacc_entry *end = entries + num_entries;
+        const tacc_entry *e = lower_bound(entries, end, key, [](const tacc_entry &x, uint64_t k) { return x.key < k; });
+        if (e == end || e->key != key) {
+            misses++;
+            return false;
+        }
+        hits++;
+        f = {key, all_records + e->first_record, e->num_records, all_strings + e->str_off, e->str_size, e->temps, e->labels};
+        used.push_back(f);
+        return true;
+    }
+
+    // Takes over freshly generated code for key
+    Function add(uint64_t key, TacRecorder &&code, uint32_t temps, uint32_t labels) {
+        owned.push_back(std::move(code));
+        const TacRecorder &c = owned.back();
+        used.push_back({key, c.records.data(), (uint32_t)c.records.size(), c.strtab.data(),
+                        (uint32_t)c.strtab.size(), temps, labels});
+        return used.back();
+    }
+
+    // Emits f with its temps and labels moved up by the given bases
+    template <class Emitter>
+    static void replay(const Function &f, int temp_base, int label_base, Emitter &emit) {
+        auto temp = [&](int32_t t) { return t >= 0 ? Temp{t + temp_base} : Temp(); };
+        for (uint32_t i = 0; i < f.num_records; i++) {
+            const tac_record &r = f.records[i];
+            string_view s(f.strtab + r.str_off, r.str_len);
+            if (r.op == TACC_BLANK) {
+                emit.blank();
+                continue;
+            }
+            switch ((TacOp)r.op) {
+            case TacOp::COPY: emit.copy(temp(r.dst), Value(s)); break;
+            case TacOp::LOAD: emit.load(temp(r.dst), s, temp(r.a)); break;
+            case TacOp::STORE: emit.store(s, temp(r.a), temp(r.b)); break;
+            case TacOp::ASSIGN: emit.assign(s, temp(r.a)); break;
+            case TacOp::BINARY: emit.binary(temp(r.dst), temp(r.a), s, temp(r.b)); break;
+            case TacOp::UNARY: emit.unary(temp(r.dst), s, temp(r.a)); break;
+            case TacOp::PARAM: emit.param(temp(r.a)); break;
+            case TacOp::CALL: emit.call(temp(r.dst), s, r.b); break;
+            case TacOp::COND_JUMP: emit.cond_jump(temp(r.a), r.dst + label_base); break;
+            case TacOp::BRANCH: emit.branch(temp(r.a), s, temp(r.b), r.dst + label_base); break;
+            case TacOp::JUMP: emit.jump(r.dst + label_base); break;
+            case TacOp::LABEL: emit.label(r.dst + label_base); break;
+            case TacOp::RETURN: emit.ret(temp(r.a)); break;
+            case TacOp::COMMENT: emit.comment(s); break;
+            default: break;
+            }
+        }
+    }
+
+    // Writes the functions used in this run, unless the file already holds
+    // exactly those. Returns false and sets reason on failure.
+    bool save(const string &path, string &reason) {
+        if (misses == 0 && (uint32_t)hits == num_entries && entries) return true;
+        vector<const Function *> order;
+        for (auto &f : used) order.push_back(&f);
+        sort(order.begin(), order.end(), [](const Function *a, const Function *b) { return a->key < b->key; });
+        order.erase(unique(order.begin(), order.end(), [](const Function *a, const Function *b) { return a->key == b->key; }),
+                    order.end());
+
+        vector<tacc_entry> out_entries;
+        uint32_t num_records = 0, strtab_size = 0;
+        for (const Function *f : order) {
+            out_entries.push_back({f->key, num_records, f->num_records, strtab_size, f->str_size, f->temps, f->labels});
+            num_records += f->num_records;
+            strtab_size += f->str_size;
+        }
+
+        tacc_header h = {};
+        memcpy(h.magic, TACC_MAGIC, sizeof(h.magic));
+        h.version = TACC_VERSION;
+        h.byte_order = TACC_BYTE_ORDER;
+        h.num_entries = out_entries.size();
+        h.num_records = num_records;
+        h.strtab_size = strtab_size;
+
+        // the old file stays mapped while the new one is written next to it
+        string tmp = path + ".tmp";
+        ofstream out(tmp, ios::binary | ios::trunc);
+        if (!out) {
+            reason = "cannot open " + tmp + " for writing";
+            return false;
+        }
+        out.write((const char *)&h, sizeof(h));
+        out.write((const char *)out_entries.data(), out_entries.size() * sizeof(tacc_entry));
+        for (const Function *f : order) out.write((const char *)f->records, f->num_records * sizeof(tac_record));
+        for (const Function *f : order) out.write(f->strtab, f->str_size);
+        out.close();
+        if (!out || rename(tmp.c_str(), path.c_str()) != 0) {
+            reason = "write to " + path + " failed";
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif // TAC_CACHE_H
@@ -0,0 +1,337 @@
+#ifndef TAC_CFG_H
+#define TAC_CFG_H
+
+#include "pass_manager.h"
+#include "tac_ir.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// Control flow graph of one unit of three-address code.
+//
+// Block b is the quads [start[b], start[b+1]) of the unit, numbered in code
+// order; block 0 is the entry. A block starts at the first quad, at every label
+// and after every jump or return. It has at most two successors, the target of
+// its last jump and the next block if control can fall through, stored in
+// succs[2b] and succs[2b+1] (NO_BLOCK when absent). Predecessors are stored
+// compressed: those of b are preds[pred_start[b] .. pred_start[b+1]).
+//
+// Reverse postorder, dominators and loops only cover blocks reachable from the
+// entry. Immediate dominators are found with the iterative algorithm of
+// Cooper, Harvey and Kennedy. A natural loop is the set of blocks that reach a
+// back edge (one whose target dominates its source) without passing through
+// the target, its header; back edges to one header make one loop. The code
+// generator only produces structured control flow, so every loop is natural.
+
+const uint32_t NO_BLOCK = UINT32_MAX;
+
+struct CfgLoop {
+    uint32_t header;
+    uint32_t parent;       // innermost enclosing loop, NO_BLOCK for an outermost one
+    uint32_t depth;        // 1 for an outermost loop
+    uint32_t first, count; // blocks are loop_blocks[first .. first+count), header first
+};
+
+struct Cfg {
+    vector<uint32_t> start;                  // num_blocks() + 1 entries
+    vector<uint32_t> succs;                  // 2 per block
+    vector<uint32_t> pred_start, preds;
+    vector<uint32_t> rpo;                    // reachable blocks in reverse postorder
+    vector<uint32_t> rpo_index;              // block -> position in rpo, NO_BLOCK if unreachable
+    vector<uint32_t> idom;                   // entry's is itself, NO_BLOCK if unreachable
+    vector<CfgLoop> loops;                   // outer loops before the loops they contain
+    vector<uint32_t> loop_blocks;
+    vector<uint32_t> innermost_loop;         // block -> loop index, NO_BLOCK if in none
+
+    uint32_t num_blocks() const { return start.size() - 1; }
+    uint32_t num_edges() const { return preds.size(); }
+    bool reachable(uint32_t b) const { return rpo_index[b] != NO_BLOCK; }
+
+    uint32_t loop_depth(uint32_t b) const {
+        return innermost_loop[b] == NO_BLOCK ? 0 : loops[innermost_loop[b]].depth;
+    }
+
+    // Whether block b is in loop l or a loop inside it
+    bool in_loop(uint32_t b, uint32_t l) const {
+        for (uint32_t k = innermost_loop[b]; k != NO_BLOCK; k = loops[k].parent) {
+            if (k == l) return true;
+        }
+        return false;
+    }
+
+    // Whether a dominates b; both must be reachable
+    bool dominates(uint32_t a, uint32_t b) const {
+        while (b != a && idom[b] != b) b = idom[b];
+        return b == a;
+    }
+};
+
+inline bool ends_block(Opcode op) {
+    return op == Opcode::JUMP || op == Opcode::COND_JUMP || is_branch(op) || op == Opcode::RETURN;
+}
+
+// The label of a jump; labels of a unit are [label_base, label_base+labels)
+inline int32_t jump_target(const Quad &q) {
+    if (q.op == Opcode::JUMP) return q.a.id;
+    if (q.op == Opcode::COND_JUMP) return q.b.id;
+    if (is_branch(q.op)) return q.dst.id;
+    return -1;
+}
+
+class CfgBuilder {
+private:
+    const TacFunction &unit;
+    Cfg &cfg;
+
+    void find_blocks(vector<uint32_t> &label_block) {
+        const vector<Quad> &code = unit.code;
+        for (uint32_t i = 0; i < code.size(); i++) {
+            bool leader = i == 0 || code[i].op == Opcode::LABEL || ends_block(code[i - 1].op);
+            if (leader && (cfg.start.empty() || cfg.start.back() != i)) cfg.start.push_back(i);
+            if (code[i].op == Opcode::LABEL) label_block[code[i].a.id - unit.label_base] = cfg.start.size() - 1;
+        }
+        if (cfg.start.empty()) cfg.start.push_back(0); // an empty unit is one empty block
+        cfg.start.push_back(code.size());
+    }
+
+    void add_edges(const vector<uint32_t> &label_block) {
+        uint32_t n = cfg.num_blocks();
+        cfg.succs.assign(2 * n, NO_BLOCK);
+        vector<uint32_t> pred_count(n + 1, 0);
+        for (uint32_t b = 0; b < n; b++) {
+            uint32_t k = 0;
+            if (cfg.start[b + 1] > cfg.start[b]) {
+                const Quad &last = unit.code[cfg.start[b + 1] - 1];
+                if (jump_target(last) >= 0) cfg.succs[2 * b + k++] = label_block[jump_target(last) - unit.label_base];
+                if (last.op != Opcode::JUMP && last.op != Opcode::RETURN && b + 1 < n) cfg.succs[2 * b + k++] = b + 1;
+            } else if (b + 1 < n) {
+                cfg.succs[2 * b + k++] = b + 1;
+            }
+            for (uint32_t i = 0; i < k; i++) pred_count[cfg.succs[2 * b + i] + 1]++;
+        }
+        for (uint32_t b = 0; b < n; b++) pred_count[b + 1] += pred_count[b];
+        cfg.pred_start = pred_count;
+        cfg.preds.resize(cfg.pred_start[n]);
+        for (uint32_t b = 0; b < n; b++) {
+            for (uint32_t i = 0; i < 2 && cfg.succs[2 * b + i] != NO_BLOCK; i++) {
+                cfg.preds[pred_count[cfg.succs[2 * b + i]]++] = b;
+            }
+        }
+    }
+
+    void number_blocks() {
+        uint32_t n = cfg.num_blocks();
+        vector<uint32_t> postorder;
+        vector<uint8_t> seen(n, 0);
+        vector<pair<uint32_t, uint32_t>> stack = {{0, 0}}; // block, next successor to look at
+        seen[0] = 1;
+        while (!stack.empty()) {
+            auto &top = stack.back();
+            uint32_t b = top.first;
+            if (top.second < 2 && cfg.succs[2 * b + top.second] != NO_BLOCK) {
+                uint32_t s = cfg.succs[2 * b + top.second++];
+                if (!seen[s]) {
+                    seen[s] = 1;
+                    stack.push_back({s, 0});
+                }
+            } else {
+                postorder.push_back(b);
+                stack.pop_back();
+            }
+        }
+        cfg.rpo.assign(postorder.rbegin(), postorder.rend());
+        cfg.rpo_index.assign(n, NO_BLOCK);
+        for (uint32_t i = 0; i < cfg.rpo.size(); i++) cfg.rpo_index[cfg.rpo[i]] = i;
+    }
+
+    void find_dominators() {
+        cfg.idom.assign(cfg.num_blocks(), NO_BLOCK);
+        cfg.idom[0] = 0;
+        auto intersect = [&](uint32_t a, uint32_t b) {
+            while (a != b) {
+                while (cfg.rpo_index[a] > cfg.rpo_index[b]) a = cfg.idom[a];
+                while (cfg.rpo_index[b] > cfg.rpo_index[a]) b = cfg.idom[b];
+            }
+            return a;
+        };
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t i = 1; i < cfg.rpo.size(); i++) {
+                uint32_t b = cfg.rpo[i], dom = NO_BLOCK;
+                for (uint32_t k = cfg.pred_start[b]; k < cfg.pred_start[b + 1]; k++) {
+                    uint32_t p = cfg.preds[k];
+                    if (cfg.idom[p] == NO_BLOCK) continue; // unreachable or not processed yet
+                    dom = dom == NO_BLOCK ? p : intersect(p, dom);
+                }
+                if (cfg.idom[b] != dom) {
+                    cfg.idom[b] = dom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    void find_loops() {
+        uint32_t n = cfg.num_blocks();
+        // bodies by header, each collected by walking back from the back edges
+        vector<vector<uint32_t>> bodies;
+        vector<uint32_t> header_loop(n, NO_BLOCK), mark(n, NO_BLOCK);
+        for (uint32_t h : cfg.rpo) {
+            for (uint32_t k = cfg.pred_start[h]; k < cfg.pred_start[h + 1]; k++) {
+                uint32_t tail = cfg.preds[k];
+                if (!cfg.reachable(tail) || !cfg.dominates(h, tail)) continue;
+                if (header_loop[h] == NO_BLOCK) {
+                    header_loop[h] = bodies.size();
+                    bodies.push_back({h});
+                    mark[h] = h;
+                }
+                vector<uint32_t> &body = bodies[header_loop[h]];
+                vector<uint32_t> work;
+                if (mark[tail] != h) {
+                    mark[tail] = h;
+                    body.push_back(tail);
+                    work.push_back(tail);
+                }
+                while (!work.empty()) {
+                    uint32_t b = work.back();
+                    work.pop_back();
+                    for (uint32_t j = cfg.pred_start[b]; j < cfg.pred_start[b + 1]; j++) {
+                        uint32_t p = cfg.preds[j];
+                        if (cfg.reachable(p) && mark[p] != h) {
+                            mark[p] = h;
+                            body.push_back(p);
+                            work.push_back(p);
+                        }
+                    }
+                }
+            }
+        }
+
+        // larger loops first: a loop's parent is then the innermost loop seen so far around its header
+        vector<uint32_t> order(bodies.size());
+        for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bodies[a].size() > bodies[b].size(); });
+        cfg.innermost_loop.assign(n, NO_BLOCK);
+        for (uint32_t i : order) {
+            vector<uint32_t> &body = bodies[i];
+            uint32_t parent = cfg.innermost_loop[body[0]];
+            uint32_t index = cfg.loops.size();
+            cfg.loops.push_back({body[0], parent, parent == NO_BLOCK ? 1 : cfg.loops[parent].depth + 1,
+                                 (uint32_t)cfg.loop_blocks.size(), (uint32_t)body.size()});
+            cfg.loop_blocks.insert(cfg.loop_blocks.end(), body.begin(), body.end());
+            for (uint32_t b : body) cfg.innermost_loop[b] = index;
+        }
+    }
+
+public:
+    CfgBuilder(const TacFunction &unit, Cfg &cfg) : unit(unit), cfg(cfg) {}
+
+    void build() {
+        vector<uint32_t> label_block(unit.labels, NO_BLOCK);
+        find_blocks(label_block);
+        add_edges(label_block);
+        number_blocks();
+        find_dominators();
+        find_loops();
+    }
+};
+
+inline Cfg build_cfg(const TacFunction &unit) {
+    Cfg cfg;
+    CfgBuilder(unit, cfg).build();
+    return cfg;
+}
+
+// Whether code put right before the header of loop l runs on entry to the loop
+// only: the header starts with a label, and the loop is entered from outside
+// only by falling through from the block before it, which is not in the loop.
+// The code generator only enters loops by falling through.
+inline bool has_preheader(const TacFunction &unit, const Cfg &cfg, uint32_t l) {
+    uint32_t header = cfg.loops[l].header;
+    const Quad &label = unit.code[cfg.start[header]];
+    if (header == 0 || label.op != Opcode::LABEL) return false;
+    if (cfg.in_loop(header - 1, l) || jump_target(unit.code[cfg.start[header] - 1]) == label.a.id) return false;
+    for (uint32_t k = cfg.pred_start[header]; k < cfg.pred_start[header + 1]; k++) {
+        uint32_t p = cfg.preds[k];
+        if (cfg.reachable(p) && !cfg.in_loop(p, l) && p != header - 1) return false;
+    }
+    return true;
+}
+
+// Calls f(cfg, l) once for each loop l of a unit, innermost loops first so
+// that what f moves out of a loop can be seen in the enclosing one. f may
+// change the code; the CFG is built again for the next loop, and loops are
+// told apart by the label of their header.
+template <class F>
+void for_each_loop_inner_first(TacFunction &unit, F f) {
+    vector<int32_t> done;
+    for (;;) {
+        Cfg cfg = build_cfg(unit);
+        uint32_t next = NO_BLOCK;
+        for (uint32_t l = 0; l < cfg.loops.size(); l++) {
+            int32_t label = unit.code[cfg.start[cfg.loops[l].header]].a.id;
+            if (find(done.begin(), done.end(), label) != done.end()) continue;
+            if (next == NO_BLOCK || cfg.loops[l].depth > cfg.loops[next].depth) next = l;
+        }
+        if (next == NO_BLOCK) return;
+        done.push_back(unit.code[cfg.start[cfg.loops[next].header]].a.id);
+        f(cfg, next);
+    }
+}
+
+// Drops the unreachable blocks of a unit, keeping their comments (the
+// declarations of the variables they use), and then the labels nothing jumps
+// to any more. Returns the number of quads removed.
+inline size_t prune_unreachable(TacFunction &unit, const Cfg &cfg) {
+    vector<Quad> kept;
+    kept.reserve(unit.code.size());
+    vector<uint8_t> targeted(unit.labels, 0);
+    for (uint32_t b = 0; b < cfg.num_blocks(); b++) {
+        for (uint32_t i = cfg.start[b]; i < cfg.start[b + 1]; i++) {
+            const Quad &q = unit.code[i];
+            if (!cfg.reachable(b) && q.op != Opcode::COMMENT) continue;
+            if (jump_target(q) >= 0) targeted[jump_target(q) - unit.label_base] = 1;
+            kept.push_back(q);
+        }
+    }
+    size_t before = unit.code.size();
+    unit.code.clear();
+    for (const Quad &q : kept) {
+        if (q.op == Opcode::LABEL && !targeted[q.a.id - unit.label_base]) continue;
+        unit.code.push_back(q);
+    }
+    return before - unit.code.size();
+}
+
+// Builds the CFG of every function (-O1) and prunes what cannot be reached
+class CfgPass : public Pass {
+public:
+    string name() const override { return "cfg"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t functions = 0, blocks = 0, edges = 0, loops = 0, unreachable = 0, removed = 0;
+        uint32_t max_depth = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (!unit.is_function()) continue;
+            Cfg cfg = build_cfg(unit);
+            functions++;
+            blocks += cfg.num_blocks();
+            edges += cfg.num_edges();
+            loops += cfg.loops.size();
+            for (auto &loop : cfg.loops) max_depth = max(max_depth, loop.depth);
+            if (cfg.rpo.size() == cfg.num_blocks()) continue;
+            unreachable += cfg.num_blocks() - cfg.rpo.size();
+            removed += prune_unreachable(unit, cfg);
+        }
+        ctx.outlog << "Control flow: " << functions << " functions, " << blocks << " basic blocks, " << edges << " edges, "
+                   << loops << " loops (nested " << max_depth << " deep); pruned " << unreachable
+                   << " unreachable blocks, " << removed << " instructions" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_CFG_H
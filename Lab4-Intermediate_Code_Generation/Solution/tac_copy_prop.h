@@ -0,0 +1,208 @@
+#ifndef TAC_COPY_PROP_H
+#define TAC_COPY_PROP_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+// Copy propagation over each function's TAC.
+//
+// A copy loads a variable or an immediate into a temp: t = x or t = 5. Temps
+// are assigned once and before every read, so a read of a copy of an immediate
+// can always be the immediate itself. A read of t = x can be x wherever x still
+// holds what the copy loaded: x is not assigned, nor a function called if x is
+// global, on any path from the copy to the read. Which copies are available
+// where is a forward dataflow problem over the CFG, solved with one bit per
+// copy. The copies themselves are left for dead code elimination.
+//
+// Then a temp whose only read assigns it to a variable later in its block
+// takes the variable's place: t = a + b; x = t becomes x = a + b, unless x is
+// read or assigned in between, or a function called with x global.
+
+class CopyPropagation {
+private:
+    TacFunction &unit;
+    const Cfg &cfg;
+    uint32_t words = 0;
+    vector<uint32_t> copy_of;    // temp - temp_base -> its copy's number, NO_BLOCK if not a copy of a variable
+    vector<Operand> source;      // copy number -> the variable copied
+    vector<Operand> immediate;   // temp - temp_base -> the immediate it holds, if any
+    unordered_map<int32_t, vector<uint32_t>> by_var; // variable -> numbers of the copies of it
+    vector<uint32_t> global_copies;
+    vector<uint64_t> avail_in;   // words per block
+
+    void add(uint64_t *set, uint32_t c) { set[c >> 6] |= 1ull << (c & 63); }
+    void remove(uint64_t *set, uint32_t c) { set[c >> 6] &= ~(1ull << (c & 63)); }
+    bool test(const uint64_t *set, uint32_t c) const { return set[c >> 6] >> (c & 63) & 1; }
+
+    void find_copies() {
+        copy_of.assign(unit.temps, NO_BLOCK);
+        immediate.assign(unit.temps, Operand());
+        for (const Quad &q : unit.code) {
+            if (q.op != Opcode::MOV || !q.dst.is_temp()) continue;
+            if (q.a.kind == OperandKind::IMM) {
+                immediate[q.dst.id - unit.temp_base] = q.a;
+            } else if (q.a.kind == OperandKind::VAR) {
+                uint32_t c = source.size();
+                copy_of[q.dst.id - unit.temp_base] = c;
+                source.push_back(q.a);
+                by_var[q.a.id].push_back(c);
+                if (!unit.is_local(q.a)) global_copies.push_back(c);
+            }
+        }
+        words = (source.size() + 63) / 64;
+    }
+
+    // Applies q to the set of available copies: what it kills, then what it makes
+    void transfer(const Quad &q, uint64_t *avail) {
+        Operand d = defined(q);
+        if (d.kind == OperandKind::VAR) {
+            auto it = by_var.find(d.id);
+            if (it != by_var.end()) {
+                for (uint32_t c : it->second) remove(avail, c);
+            }
+        }
+        if (q.op == Opcode::CALL) {
+            for (uint32_t c : global_copies) remove(avail, c);
+        }
+        if (d.is_temp() && copy_of[d.id - unit.temp_base] != NO_BLOCK) add(avail, copy_of[d.id - unit.temp_base]);
+    }
+
+    void find_available() {
+        uint32_t n = cfg.num_blocks(), w = words;
+        // out sets start full so the intersection over a loop's back edge does not empty them
+        vector<uint64_t> avail_out(n * w, ~0ull);
+        avail_in.assign(n * w, 0);
+        vector<uint64_t> set(w);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t b : cfg.rpo) {
+                uint64_t *in = avail_in.data() + b * w;
+                bool first = true;
+                for (uint32_t k = cfg.pred_start[b]; k < cfg.pred_start[b + 1]; k++) {
+                    uint32_t p = cfg.preds[k];
+                    if (!cfg.reachable(p)) continue;
+                    for (uint32_t j = 0; j < w; j++) in[j] = first ? avail_out[p * w + j] : in[j] & avail_out[p * w + j];
+                    first = false;
+                }
+                if (first) fill(in, in + w, 0); // the entry
+                set.assign(in, in + w);
+                for (uint32_t i = cfg.start[b]; i < cfg.start[b + 1]; i++) transfer(unit.code[i], set.data());
+                if (!equal(set.begin(), set.end(), avail_out.data() + b * w)) {
+                    copy(set.begin(), set.end(), avail_out.data() + b * w);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    size_t replace_reads() {
+        size_t replaced = 0;
+        vector<uint64_t> avail(words);
+        for (uint32_t b : cfg.rpo) {
+            avail.assign(avail_in.data() + b * words, avail_in.data() + (b + 1) * words);
+            for (uint32_t i = cfg.start[b]; i < cfg.start[b + 1]; i++) {
+                Quad &q = unit.code[i];
+                for_each_use(q, [&](Operand &o) {
+                    if (!o.is_temp()) return;
+                    uint32_t t = o.id - unit.temp_base;
+                    if (immediate[t]) {
+                        o = immediate[t];
+                        replaced++;
+                    } else if (copy_of[t] != NO_BLOCK && test(avail.data(), copy_of[t])) {
+                        o = source[copy_of[t]];
+                        replaced++;
+                    }
+                });
+                transfer(q, avail.data());
+            }
+        }
+        return replaced;
+    }
+
+    // Whether the quads between def and use (both excluded) leave x alone
+    bool untouched_between(uint32_t def, uint32_t use, const Operand &x) const {
+        bool global = !unit.is_local(x);
+        for (uint32_t i = def + 1; i < use; i++) {
+            const Quad &q = unit.code[i];
+            if (q.op == Opcode::LABEL || ends_block(q.op) || defined(q) == x) return false;
+            if (q.op == Opcode::CALL && global) return false;
+            bool read = false;
+            for_each_use(q, [&](const Operand &o) { read |= o == x; });
+            if (read) return false;
+        }
+        return true;
+    }
+
+    size_t fold_assignments() {
+        vector<uint32_t> reads(unit.temps, 0), def_at(unit.temps, NO_BLOCK);
+        for (uint32_t i = 0; i < unit.code.size(); i++) {
+            const Quad &q = unit.code[i];
+            for_each_use(q, [&](const Operand &o) {
+                if (o.is_temp()) reads[o.id - unit.temp_base]++;
+            });
+            if (q.dst.is_temp() && defined(q)) def_at[q.dst.id - unit.temp_base] = i;
+        }
+        size_t folded = 0;
+        vector<uint8_t> gone(unit.code.size(), 0);
+        for (uint32_t i = 0; i < unit.code.size(); i++) {
+            Quad &q = unit.code[i];
+            if (q.op != Opcode::MOV || q.dst.kind != OperandKind::VAR || !q.a.is_temp()) continue;
+            uint32_t t = q.a.id - unit.temp_base;
+            if (reads[t] != 1 || def_at[t] == NO_BLOCK || def_at[t] > i) continue;
+            if (!untouched_between(def_at[t], i, q.dst)) continue;
+            unit.code[def_at[t]].dst = q.dst;
+            gone[i] = 1;
+            folded++;
+        }
+        size_t kept = 0;
+        for (size_t i = 0; i < unit.code.size(); i++) {
+            if (!gone[i]) unit.code[kept++] = unit.code[i];
+        }
+        unit.code.resize(kept);
+        return folded;
+    }
+
+public:
+    size_t replaced = 0, folded = 0;
+
+    CopyPropagation(TacFunction &unit, const Cfg &cfg) : unit(unit), cfg(cfg) {}
+
+    void run() {
+        find_copies();
+        find_available();
+        replaced = replace_reads();
+        folded = fold_assignments();
+    }
+};
+
+// Copy propagation on every function (-O1); dce then removes the copies
+class CopyPropagationPass : public Pass {
+public:
+    string name() const override { return "copy-prop"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"dce", "print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t replaced = 0, folded = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (!unit.is_function() || !unit.single_assignment()) continue;
+            Cfg cfg = build_cfg(unit);
+            CopyPropagation prop(unit, cfg);
+            prop.run();
+            replaced += prop.replaced;
+            folded += prop.folded;
+        }
+        ctx.outlog << "Copy propagation: " << replaced << " operands replaced, " << folded
+                   << " results assigned to their variable directly" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_COPY_PROP_H
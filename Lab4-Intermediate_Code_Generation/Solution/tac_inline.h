@@ -0,0 +1,269 @@
+#ifndef TAC_INLINE_H
+#define TAC_INLINE_H
+
+#include "pass_manager.h"
+#include "tac_ir.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// Inlining of small functions at their call sites.
+//
+// A call f(a1, .., an) is the quads param a1 .. param an; t = call f, n. It is
+// replaced by f's code: each parameter of f is assigned its argument, f's
+// temps and labels get fresh numbers in the caller, and its parameters and
+// local variables are renamed f.x so they cannot meet the caller's. A return
+// at the very end of f assigns its value to t; any other return assigns it to
+// the variable f.ret and jumps past the inlined code, where t takes f.ret.
+//
+// Functions are visited callees first, so a caller takes in its callees'
+// code after their own calls were inlined. A call is inlined if f is defined,
+// is not part of a cycle of calls (recursion, direct or mutual), and has at
+// most INLINE_SIZE quads, not counting labels and comments; and while the
+// caller has grown by less than INLINE_GROWTH quads or its own size, whichever
+// is more. f is left alone if a variable of f has the name of a global, or f
+// uses a global that the caller declares locally, since the code cannot tell
+// those apart. f itself stays in the program.
+//
+// Inlining adds temps and labels to the callers, so at the end all units are
+// numbered again, in order, as the code generator numbers them.
+
+const int INLINE_SIZE = 16;
+const int INLINE_GROWTH = 64;
+
+class Inliner {
+private:
+    TacProgram &program;
+    ostream &log;
+    unordered_map<int32_t, uint32_t> by_name; // function string id -> unit
+    vector<vector<uint32_t>> callees;         // unit -> units it calls
+    vector<uint8_t> recursive;                // unit -> in a cycle of calls
+    vector<uint32_t> order;                   // functions, callees first
+
+    static int size(const TacFunction &f) {
+        int n = 0;
+        for (const Quad &q : f.code) n += q.op != Opcode::LABEL && q.op != Opcode::COMMENT;
+        return n;
+    }
+
+    void build_call_graph() {
+        callees.assign(program.units.size(), {});
+        for (uint32_t u = 0; u < program.units.size(); u++) {
+            const TacFunction &f = program.units[u];
+            if (f.is_function()) by_name.emplace(f.name, u);
+        }
+        for (uint32_t u = 0; u < program.units.size(); u++) {
+            for (const Quad &q : program.units[u].code) {
+                if (q.op != Opcode::CALL) continue;
+                auto it = by_name.find(q.a.id);
+                if (it != by_name.end()) callees[u].push_back(it->second);
+            }
+        }
+    }
+
+    // Tarjan's strongly connected components; each is complete after the
+    // components it calls, so they come out callees first
+    struct Tarjan {
+        const vector<vector<uint32_t>> &edges;
+        vector<uint32_t> index, low, stack, components;
+        vector<uint8_t> on_stack, in_cycle;
+        uint32_t next = 0;
+
+        explicit Tarjan(const vector<vector<uint32_t>> &edges)
+            : edges(edges), index(edges.size(), NO_INDEX), low(edges.size()), on_stack(edges.size()),
+              in_cycle(edges.size()) {}
+
+        static constexpr uint32_t NO_INDEX = UINT32_MAX;
+
+        void visit(uint32_t v) {
+            index[v] = low[v] = next++;
+            stack.push_back(v);
+            on_stack[v] = 1;
+            for (uint32_t w : edges[v]) {
+                if (index[w] == NO_INDEX) {
+                    visit(w);
+                    low[v] = min(low[v], low[w]);
+                } else if (on_stack[w]) {
+                    low[v] = min(low[v], index[w]);
+                }
+                if (w == v) in_cycle[v] = 1;
+            }
+            if (low[v] != index[v]) return;
+            size_t first = stack.size();
+            do first--;
+            while (stack[first] != v);
+            for (size_t k = first; k < stack.size(); k++) {
+                on_stack[stack[k]] = 0;
+                if (stack.size() - first > 1) in_cycle[stack[k]] = 1;
+                components.push_back(stack[k]);
+            }
+            stack.resize(first);
+        }
+    };
+
+    void order_functions() {
+        Tarjan tarjan(callees);
+        for (uint32_t u = 0; u < program.units.size(); u++) {
+            if (tarjan.index[u] == Tarjan::NO_INDEX) tarjan.visit(u);
+        }
+        recursive = std::move(tarjan.in_cycle);
+        for (uint32_t u : tarjan.components) {
+            if (program.units[u].is_function()) order.push_back(u);
+        }
+    }
+
+    int32_t renamed(const TacFunction &callee, int32_t var) {
+        return program.intern(program.str(callee.name) + "." + program.str(var));
+    }
+
+    // Whether the callee's code means the same in the caller
+    bool fits(const TacFunction &caller, const TacFunction &callee) const {
+        if (callee.shadows_global) return false;
+        for (const Quad &q : callee.code) {
+            bool clash = false;
+            auto check = [&](const Operand &o) {
+                clash |= o.kind == OperandKind::VAR && !callee.is_local(o) && caller.is_local(o);
+            };
+            check(q.dst);
+            check(q.a);
+            check(q.b);
+            if (clash) return false;
+        }
+        return true;
+    }
+
+    // Appends the callee's code in place of a call to out; args are the call's
+    // param quads
+    void expand(TacFunction &caller, const TacFunction &callee, const Quad &call, const Quad *args,
+                vector<Quad> &out, vector<int32_t> &new_locals) {
+        int32_t temp_delta = caller.temp_base + caller.temps - callee.temp_base;
+        int32_t label_delta = caller.label_base + caller.labels - callee.label_base;
+        caller.temps += callee.temps;
+        caller.labels += callee.labels;
+
+        unordered_map<int32_t, int32_t> names;
+        for (int32_t v : callee.locals) {
+            int32_t r = renamed(callee, v);
+            names.emplace(v, r);
+            new_locals.push_back(r);
+        }
+        auto move = [&](Operand o) {
+            if (o.kind == OperandKind::TEMP) o.id += temp_delta;
+            else if (o.kind == OperandKind::LABEL) o.id += label_delta;
+            else if (o.kind == OperandKind::VAR) {
+                auto it = names.find(o.id);
+                if (it != names.end()) o.id = it->second;
+            }
+            return o;
+        };
+
+        out.push_back({Opcode::COMMENT, Operand(), program.text("Inlined: " + program.str(callee.name)), Operand()});
+        for (size_t k = 0; k < callee.params.size(); k++) {
+            out.push_back({Opcode::MOV, move({OperandKind::VAR, callee.params[k]}), args[k].a, Operand()});
+        }
+
+        // the last quad but comments; a return there needs no jump
+        size_t last = callee.code.size();
+        while (last > 0 && callee.code[last - 1].op == Opcode::COMMENT) last--;
+        bool one_return = true;
+        for (size_t k = 0; k < callee.code.size(); k++) {
+            if (callee.code[k].op == Opcode::RETURN && k + 1 != last) one_return = false;
+        }
+        Operand result = one_return ? call.dst : Operand{OperandKind::VAR, program.intern(program.str(callee.name) + ".ret")};
+        Operand end;
+        if (!one_return) {
+            end = Operand::label(caller.label_base + caller.labels++);
+            new_locals.push_back(result.id);
+        }
+
+        for (size_t k = 0; k < callee.code.size(); k++) {
+            const Quad &q = callee.code[k];
+            if (q.op == Opcode::COMMENT) continue;
+            if (q.op != Opcode::RETURN) {
+                out.push_back({q.op, move(q.dst), move(q.a), move(q.b)});
+                continue;
+            }
+            if (q.a && result) out.push_back({Opcode::MOV, result, move(q.a), Operand()});
+            if (k + 1 != last) out.push_back({Opcode::JUMP, Operand(), end, Operand()});
+        }
+        if (!one_return) {
+            out.push_back({Opcode::LABEL, Operand(), end, Operand()});
+            if (call.dst) out.push_back({Opcode::MOV, call.dst, result, Operand()});
+        }
+    }
+
+public:
+    size_t inlined = 0;
+
+    Inliner(TacProgram &program, ostream &log) : program(program), log(log) {}
+
+    void run() {
+        build_call_graph();
+        order_functions();
+        vector<Quad> out;
+        for (uint32_t u : order) {
+            TacFunction &caller = program.units[u];
+            if (!caller.single_assignment()) continue;
+            int before = size(caller), grown = 0;
+            int budget = max(INLINE_GROWTH, before);
+            vector<int32_t> new_locals;
+            out.clear();
+            for (size_t k = 0; k < caller.code.size(); k++) {
+                const Quad &q = caller.code[k];
+                out.push_back(q);
+                if (q.op != Opcode::CALL) continue;
+                auto it = by_name.find(q.a.id);
+                if (it == by_name.end() || recursive[it->second]) continue;
+                const TacFunction &callee = program.units[it->second];
+                size_t nargs = callee.params.size();
+                int cost = size(callee) - 1; // the params become assignments and the call goes
+                if (size(callee) > INLINE_SIZE || grown + cost > budget) continue;
+                if (nargs > k || program.str(q.b) != to_string(nargs) || !callee.single_assignment()) continue;
+                bool params = true;
+                for (size_t j = k - nargs; j < k; j++) params &= caller.code[j].op == Opcode::PARAM;
+                if (!params || !fits(caller, callee)) continue;
+
+                out.resize(out.size() - 1 - nargs);
+                expand(caller, callee, q, &caller.code[k - nargs], out, new_locals);
+                grown += cost;
+                inlined++;
+                log << "Inlined call to " << program.str(callee.name) << " in " << program.str(caller.name) << endl;
+            }
+            if (!grown) continue;
+            caller.code.swap(out);
+            caller.locals.insert(caller.locals.end(), new_locals.begin(), new_locals.end());
+            sort(caller.locals.begin(), caller.locals.end());
+            caller.locals.erase(unique(caller.locals.begin(), caller.locals.end()), caller.locals.end());
+        }
+        if (!inlined) return;
+
+        // number temps and labels across the program again
+        int32_t temps = 0, labels = 0;
+        for (TacFunction &f : program.units) {
+            f.rebase(temps - f.temp_base, labels - f.label_base);
+            temps += f.temps;
+            labels += f.labels;
+        }
+    }
+};
+
+// Inlining of small functions (-O1), before the other optimizations see the code
+class InlinePass : public Pass {
+public:
+    string name() const override { return "inline"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"cfg", "lvn", "print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        Inliner inliner(ctx.tac, ctx.outlog);
+        inliner.run();
+        ctx.outlog << "Inlining: " << inliner.inlined << " calls inlined" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_INLINE_H
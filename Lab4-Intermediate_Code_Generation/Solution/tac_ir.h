@@ -0,0 +1,349 @@
+#ifndef TAC_IR_H
+#define TAC_IR_H
+
+#include "emitter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// In-memory three-address code.
+//
+// A program is a list of units in source order: the code of each function and,
+// between functions, the comments for global declarations. A unit is a vector
+// of quads, an opcode and up to three operands. An operand is a temp or label
+// number, or the id of a string in the program's pool: a variable, a function,
+// an immediate (the literal as written in the source) or comment text. Temps
+// and labels are numbered across the whole program, as they are printed.
+// Generated code has temps in every operand and destination but the source of
+// a copy; optimized code also has variables and immediates there.
+//
+// The code generator builds this IR and print_tac() drives an emitter
+// (emitter.h) over it to write code.txt, code.bin or the instruction counts.
+
+enum class OperandKind : uint8_t { NONE, TEMP, LABEL, VAR, FUNC, IMM, TEXT };
+
+struct Operand {
+    OperandKind kind = OperandKind::NONE;
+    int32_t id = 0; // temp or label number, or string id
+
+    explicit operator bool() const { return kind != OperandKind::NONE; }
+    bool operator==(const Operand &o) const { return kind == o.kind && id == o.id; }
+    bool operator!=(const Operand &o) const { return !(*this == o); }
+    bool is_temp() const { return kind == OperandKind::TEMP; }
+    bool is_string() const { return kind >= OperandKind::VAR; }
+
+    static Operand temp(Temp t) { return t ? Operand{OperandKind::TEMP, t.n} : Operand(); }
+    static Operand label(int l) { return {OperandKind::LABEL, l}; }
+};
+
+enum class Opcode : uint8_t {
+    MOV,       // dst = a
+    LOAD,      // dst = a[b]
+    STORE,     // dst[a] = b
+    // dst = a op b
+    ADD, SUB, MUL, DIV, MOD, LT, LE, GT, GE, EQ, NE, AND, OR,
+    // dst = op a
+    NEG, POS, NOT,
+    // if a op b goto dst
+    IF_LT, IF_LE, IF_GT, IF_GE, IF_EQ, IF_NE,
+    PARAM,     // param a
+    CALL,      // dst = call a, b     (b is the argument count)
+    COND_JUMP, // if a goto b
+    JUMP,      // goto a
+    LABEL,     // a:
+    RETURN,    // return a
+    COMMENT,   // // a
+    COUNT
+};
+
+// Operator of each arithmetic, relational, logical, unary and branch opcode, as printed
+const char *const OPCODE_SYMBOLS[] = {
+    "", "", "",
+    "+", "-", "*", "/", "%", "<", "<=", ">", ">=", "==", "!=", "&&", "||",
+    "-", "+", "!",
+    "<", "<=", ">", ">=", "==", "!=",
+};
+
+inline bool is_binary(Opcode op) { return op >= Opcode::ADD && op <= Opcode::OR; }
+inline bool is_unary(Opcode op) { return op >= Opcode::NEG && op <= Opcode::NOT; }
+inline bool is_relational(Opcode op) { return op >= Opcode::LT && op <= Opcode::NE; }
+inline bool is_branch(Opcode op) { return op >= Opcode::IF_LT && op <= Opcode::IF_NE; }
+
+// The branch taken when a relation holds
+inline Opcode branch_opcode(Opcode rel) { return (Opcode)((int)Opcode::IF_LT + (int)rel - (int)Opcode::LT); }
+
+// The relation that holds exactly when rel does not
+inline Opcode negate_relation(Opcode rel) {
+    switch (rel) {
+    case Opcode::LT: return Opcode::GE;
+    case Opcode::LE: return Opcode::GT;
+    case Opcode::GT: return Opcode::LE;
+    case Opcode::GE: return Opcode::LT;
+    case Opcode::EQ: return Opcode::NE;
+    default: return Opcode::EQ;
+    }
+}
+
+// COUNT for an operator the language does not have
+inline Opcode branch_opcode(string_view op) {
+    for (int k = (int)Opcode::IF_LT; k <= (int)Opcode::IF_NE; k++) {
+        if (op == OPCODE_SYMBOLS[k]) return (Opcode)k;
+    }
+    return Opcode::COUNT;
+}
+
+inline Opcode binary_opcode(string_view op) {
+    for (int k = (int)Opcode::ADD; k <= (int)Opcode::OR; k++) {
+        if (op == OPCODE_SYMBOLS[k]) return (Opcode)k;
+    }
+    return Opcode::COUNT;
+}
+
+inline Opcode unary_opcode(string_view op) {
+    for (int k = (int)Opcode::NEG; k <= (int)Opcode::NOT; k++) {
+        if (op == OPCODE_SYMBOLS[k]) return (Opcode)k;
+    }
+    return Opcode::COUNT;
+}
+
+struct Quad {
+    Opcode op;
+    Operand dst, a, b;
+};
+
+// The variable or temp a quad assigns; none for a store, which writes only part
+// of an array, and for the instructions without a result
+inline Operand defined(const Quad &q) {
+    if (q.op == Opcode::MOV || q.op == Opcode::LOAD || q.op == Opcode::CALL || is_binary(q.op) || is_unary(q.op)) {
+        return q.dst;
+    }
+    return Operand();
+}
+
+// Calls f on each operand a quad reads: temps, variables and immediates. The
+// array of a load or store, a function and a label are not operands.
+template <class QuadRef, class F>
+void for_each_use(QuadRef &q, F f) {
+    switch (q.op) {
+    case Opcode::LOAD: f(q.b); break;
+    case Opcode::STORE: f(q.a); f(q.b); break;
+    case Opcode::MOV: case Opcode::PARAM: case Opcode::COND_JUMP: case Opcode::RETURN: f(q.a); break;
+    default:
+        if (is_binary(q.op) || is_branch(q.op)) {
+            f(q.a);
+            f(q.b);
+        } else if (is_unary(q.op)) {
+            f(q.a);
+        }
+        break;
+    }
+}
+
+struct TacFunction {
+    int32_t name = -1;      // string id; -1 for global declarations
+    vector<Quad> code;
+    // string ids of the parameters and local variables, sorted; a name that is
+    // also global is left out, as the code does not tell the two apart
+    vector<int32_t> locals;
+    vector<int32_t> params;      // string ids of the parameters, in order
+    bool shadows_global = false; // a parameter or local variable has the name of a global
+    // temps and labels created in this unit, [base, base + count)
+    int32_t temp_base = 0, temps = 0;
+    int32_t label_base = 0, labels = 0;
+
+    bool is_function() const { return name >= 0; }
+
+    bool owns(const Operand &o) const { return !o.is_temp() || (o.id >= temp_base && o.id < temp_base + temps); }
+
+    // Whether every temp is the unit's own
+    bool own_temps() const {
+        for (const Quad &q : code) {
+            if (!owns(q.dst) || !owns(q.a) || !owns(q.b)) return false;
+        }
+        return true;
+    }
+
+    // Whether every temp is the unit's own and assigned at most once, as in
+    // generated code; optimizations rely on it and leave other units alone
+    bool single_assignment() const {
+        vector<uint8_t> assigned(temps, 0);
+        for (const Quad &q : code) {
+            if (!owns(q.dst) || !owns(q.a) || !owns(q.b)) return false;
+            if (q.dst.is_temp() && assigned[q.dst.id - temp_base]++) return false;
+        }
+        return true;
+    }
+
+    // A temp for this unit, after every other
+    Operand new_temp() { return Operand::temp(Temp{temp_base + temps++}); }
+
+    // Whether only this function can see the variable
+    bool is_local(const Operand &var) const {
+        return var.kind == OperandKind::VAR && binary_search(locals.begin(), locals.end(), var.id);
+    }
+
+    // Moves every temp and label of the unit up by the given amounts
+    void rebase(int32_t temp_delta, int32_t label_delta) {
+        auto move = [&](Operand &o) {
+            if (o.kind == OperandKind::TEMP) o.id += temp_delta;
+            else if (o.kind == OperandKind::LABEL) o.id += label_delta;
+        };
+        for (Quad &q : code) {
+            move(q.dst);
+            move(q.a);
+            move(q.b);
+        }
+        temp_base += temp_delta;
+        label_base += label_delta;
+    }
+};
+
+class TacProgram {
+private:
+    deque<string> strings; // deque so the views in string_ids stay valid
+    unordered_map<string_view, int32_t> string_ids;
+
+public:
+    vector<TacFunction> units;
+
+    TacProgram() {}
+    TacProgram(const TacProgram &) = delete;
+    TacProgram &operator=(const TacProgram &) = delete;
+
+    int32_t intern(string_view s) {
+        auto it = string_ids.find(s);
+        if (it != string_ids.end()) return it->second;
+        strings.emplace_back(s);
+        int32_t id = strings.size() - 1;
+        string_ids.emplace(strings.back(), id);
+        return id;
+    }
+
+    Operand string_operand(OperandKind kind, string_view s) { return {kind, intern(s)}; }
+
+    // Comment text is rarely repeated and is not looked up
+    Operand text(string s) {
+        strings.push_back(std::move(s));
+        return {OperandKind::TEXT, (int32_t)strings.size() - 1};
+    }
+
+    Operand imm(long long value) {
+        char buf[24];
+        return string_operand(OperandKind::IMM, string_view(buf, to_chars(buf, buf + sizeof(buf), value).ptr - buf));
+    }
+
+    const string &str(int32_t id) const { return strings[id]; }
+    const string &str(const Operand &o) const { return strings[o.id]; }
+
+    size_t instructions() const {
+        size_t n = 0;
+        for (auto &u : units) n += u.code.size();
+        return n;
+    }
+};
+
+// Appends code given through the emitter interface to one unit of a program,
+// so code kept in emitter form (the TAC cache) can be read back into the IR.
+// Empty lines are layout and are left to the printer.
+class TacBuilder {
+private:
+    TacProgram &program;
+    size_t unit;
+
+    void add(Opcode op, Operand dst, Operand a = Operand(), Operand b = Operand()) {
+        program.units[unit].code.push_back({op, dst, a, b});
+    }
+
+    Operand var(string_view name) { return program.string_operand(OperandKind::VAR, name); }
+
+    Operand value(Value v) {
+        if (v.temp) return Operand::temp(v.temp);
+        if (v.text.empty()) return Operand();
+        // constants folded at -O1 may be negative
+        size_t lead = v.text[0] == '-';
+        bool literal = v.text.size() > lead && (isdigit((unsigned char)v.text[lead]) || v.text[lead] == '.');
+        return program.string_operand(literal ? OperandKind::IMM : OperandKind::VAR, v.text);
+    }
+
+public:
+    TacBuilder(TacProgram &program, size_t unit) : program(program), unit(unit) {}
+
+    void begin() {}
+    void end() {}
+
+    void comment(string_view text) { add(Opcode::COMMENT, Operand(), program.text(string(text))); }
+    void blank() {}
+
+    void copy(Temp dst, Value src) { add(Opcode::MOV, Operand::temp(dst), value(src)); }
+    void load(Value dst, string_view array, Value offset) { add(Opcode::LOAD, value(dst), var(array), value(offset)); }
+    void store(string_view array, Value offset, Value src) { add(Opcode::STORE, var(array), value(offset), value(src)); }
+    void assign(string_view name, Value src) { add(Opcode::MOV, var(name), value(src)); }
+    void binary(Value dst, Value a, string_view op, Value b) { add(binary_opcode(op), value(dst), value(a), value(b)); }
+    void unary(Value dst, string_view op, Value a) { add(unary_opcode(op), value(dst), value(a)); }
+    void param(Value a) { add(Opcode::PARAM, Operand(), value(a)); }
+    void call(Value dst, string_view func, int nargs) {
+        add(Opcode::CALL, value(dst), program.string_operand(OperandKind::FUNC, func), program.imm(nargs));
+    }
+    void cond_jump(Value a, int l) { add(Opcode::COND_JUMP, Operand(), value(a), Operand::label(l)); }
+    void branch(Value a, string_view op, Value b, int l) { add(branch_opcode(op), Operand::label(l), value(a), value(b)); }
+    void jump(int l) { add(Opcode::JUMP, Operand(), Operand::label(l)); }
+    void label(int l) { add(Opcode::LABEL, Operand(), Operand::label(l)); }
+    void ret(Value a) { add(Opcode::RETURN, Operand(), value(a)); }
+};
+
+// Prints one quad through an emitter
+template <class Emitter>
+void print_quad(const TacProgram &program, const Quad &q, Emitter &emit) {
+    auto text = [&](const Operand &o) -> string_view { return o.is_string() ? string_view(program.str(o)) : string_view(); };
+    auto value = [&](const Operand &o) { return o.is_temp() ? Value(Temp{o.id}) : Value(text(o)); };
+
+    switch (q.op) {
+    case Opcode::MOV:
+        if (q.dst.is_temp()) emit.copy(Temp{q.dst.id}, value(q.a));
+        else emit.assign(text(q.dst), value(q.a));
+        break;
+    case Opcode::LOAD: emit.load(value(q.dst), text(q.a), value(q.b)); break;
+    case Opcode::STORE: emit.store(text(q.dst), value(q.a), value(q.b)); break;
+    case Opcode::PARAM: emit.param(value(q.a)); break;
+    case Opcode::CALL: {
+        int nargs = 0;
+        const string &n = program.str(q.b);
+        from_chars(n.data(), n.data() + n.size(), nargs);
+        emit.call(value(q.dst), text(q.a), nargs);
+        break;
+    }
+    case Opcode::COND_JUMP: emit.cond_jump(value(q.a), q.b.id); break;
+    case Opcode::JUMP: emit.jump(q.a.id); break;
+    case Opcode::LABEL: emit.label(q.a.id); break;
+    case Opcode::RETURN: emit.ret(value(q.a)); break;
+    case Opcode::COMMENT: emit.comment(text(q.a)); break;
+    default:
+        if (is_binary(q.op)) emit.binary(value(q.dst), value(q.a), OPCODE_SYMBOLS[(int)q.op], value(q.b));
+        else if (is_unary(q.op)) emit.unary(value(q.dst), OPCODE_SYMBOLS[(int)q.op], value(q.a));
+        else if (is_branch(q.op)) emit.branch(value(q.a), OPCODE_SYMBOLS[(int)q.op], value(q.b), q.dst.id);
+        break;
+    }
+}
+
+// Prints one unit; a function is followed by an empty line
+template <class Emitter>
+void print_unit(const TacProgram &program, const TacFunction &unit, Emitter &emit) {
+    for (const Quad &q : unit.code) print_quad(program, q, emit);
+    if (unit.is_function()) emit.blank();
+}
+
+template <class Emitter>
+void print_tac(const TacProgram &program, Emitter &emit) {
+    emit.begin();
+    for (const TacFunction &unit : program.units) print_unit(program, unit, emit);
+    emit.end();
+}
+
+#endif // TAC_IR_H
@@ -0,0 +1,181 @@
+#ifndef TAC_LICM_H
+#define TAC_LICM_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// Loop-invariant code motion over the natural loops of each function.
+//
+// A quad in a loop is invariant if each operand is an immediate, a temp
+// defined outside the loop or by an invariant quad, or a variable whose
+// reaching definitions all lie outside the loop: no quad in the loop assigns
+// it, and no call does if it is global. An invariant copy, arithmetic or
+// unary quad whose result is a temp moves to the loop's preheader, the end of
+// the code that falls through into the header from outside. Temps are
+// assigned once, so computing one early is harmless when the loop would not
+// have needed it, provided the quad cannot trap: division and modulus only
+// move with a constant divisor other than 0 and -1. A load moves when nothing
+// in the loop stores to its array (nor calls a function, for a global array)
+// and its block dominates every exit and return, so the loop would have done
+// it anyway.
+//
+// Inner loops go first, so what leaves them can leave the enclosing loop too.
+// A loop without a preheader (see has_preheader) is left alone.
+
+class LoopInvariantMotion {
+private:
+    TacFunction &unit;
+    const TacProgram &program;
+    vector<uint32_t> def_at;    // temp - temp_base -> index of its definition, NO_BLOCK if none
+    vector<uint32_t> block_of;  // quad index -> block
+    vector<uint8_t> in_loop;    // block -> in the loop being moved out of
+    vector<uint8_t> invariant;  // quad index -> found invariant
+    vector<int32_t> assigned, stored; // string ids of the variables and arrays the loop writes, sorted
+    bool calls = false;
+
+    static bool contains(const vector<int32_t> &set, int32_t id) { return binary_search(set.begin(), set.end(), id); }
+
+    bool invariant_operand(const Operand &o) const {
+        switch (o.kind) {
+        case OperandKind::IMM: return true;
+        case OperandKind::VAR: return !contains(assigned, o.id) && !(calls && !unit.is_local(o));
+        case OperandKind::TEMP: {
+            uint32_t d = def_at[o.id - unit.temp_base];
+            return d != NO_BLOCK && (!in_loop[block_of[d]] || invariant[d]);
+        }
+        default: return false;
+        }
+    }
+
+    bool safe_divisor(const Operand &o) const {
+        if (o.kind != OperandKind::IMM) return false;
+        const string &text = program.str(o);
+        char *end;
+        double v = strtod(text.c_str(), &end);
+        return !*end && v != 0 && v != -1;
+    }
+
+    // Whether q may be computed once before the loop
+    bool movable(const Quad &q, bool runs_every_time) const {
+        if (!q.dst.is_temp()) return false;
+        if (q.op == Opcode::LOAD) {
+            if (!runs_every_time || contains(stored, q.a.id) || (calls && !unit.is_local(q.a))) return false;
+            return invariant_operand(q.b);
+        }
+        if (q.op == Opcode::MOV || is_unary(q.op)) return invariant_operand(q.a);
+        if (!is_binary(q.op)) return false;
+        if ((q.op == Opcode::DIV || q.op == Opcode::MOD) && !safe_divisor(q.b)) return false;
+        return invariant_operand(q.a) && invariant_operand(q.b);
+    }
+
+public:
+    LoopInvariantMotion(TacFunction &unit, const TacProgram &program) : unit(unit), program(program) {}
+
+    // Moves the invariant quads of loop l to its preheader; returns how many
+    size_t hoist(const Cfg &cfg, uint32_t l) {
+        if (!has_preheader(unit, cfg, l)) return 0;
+        const CfgLoop &loop = cfg.loops[l];
+        uint32_t n = cfg.num_blocks();
+        in_loop.assign(n, 0);
+        for (uint32_t k = loop.first; k < loop.first + loop.count; k++) in_loop[cfg.loop_blocks[k]] = 1;
+
+        block_of.resize(unit.code.size());
+        def_at.assign(unit.temps, NO_BLOCK);
+        assigned.clear();
+        stored.clear();
+        calls = false;
+        for (uint32_t b = 0; b < n; b++) {
+            for (uint32_t i = cfg.start[b]; i < cfg.start[b + 1]; i++) {
+                const Quad &q = unit.code[i];
+                block_of[i] = b;
+                Operand d = defined(q);
+                if (d.is_temp()) def_at[d.id - unit.temp_base] = i;
+                if (!in_loop[b]) continue;
+                if (d.kind == OperandKind::VAR) assigned.push_back(d.id);
+                if (q.op == Opcode::STORE) stored.push_back(q.dst.id);
+                if (q.op == Opcode::CALL) calls = true;
+            }
+        }
+        sort(assigned.begin(), assigned.end());
+        sort(stored.begin(), stored.end());
+
+        // blocks that leave the loop or return; those dominating all of them run on every trip
+        vector<uint32_t> blocks(cfg.loop_blocks.begin() + loop.first, cfg.loop_blocks.begin() + loop.first + loop.count);
+        sort(blocks.begin(), blocks.end());
+        vector<uint32_t> exits;
+        for (uint32_t b : blocks) {
+            if (unit.code[cfg.start[b + 1] - 1].op == Opcode::RETURN) {
+                exits.push_back(b);
+                continue;
+            }
+            for (uint32_t i = 0; i < 2; i++) {
+                uint32_t s = cfg.succs[2 * b + i];
+                if (s != NO_BLOCK && !in_loop[s]) {
+                    exits.push_back(b);
+                    break;
+                }
+            }
+        }
+
+        invariant.assign(unit.code.size(), 0);
+        vector<uint32_t> moved;
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t b : blocks) {
+                bool every_time = !exits.empty();
+                for (uint32_t e : exits) every_time &= cfg.dominates(b, e);
+                for (uint32_t i = cfg.start[b]; i < cfg.start[b + 1]; i++) {
+                    if (invariant[i] || !movable(unit.code[i], every_time)) continue;
+                    invariant[i] = 1;
+                    moved.push_back(i);
+                    changed = true;
+                }
+            }
+        }
+        if (moved.empty()) return 0;
+
+        vector<Quad> code;
+        code.reserve(unit.code.size());
+        uint32_t at = cfg.start[loop.header];
+        code.insert(code.end(), unit.code.begin(), unit.code.begin() + at);
+        for (uint32_t i : moved) code.push_back(unit.code[i]);
+        for (uint32_t i = at; i < unit.code.size(); i++) {
+            if (!invariant[i]) code.push_back(unit.code[i]);
+        }
+        unit.code.swap(code);
+        return moved.size();
+    }
+};
+
+// Loop-invariant code motion on every function (-O1)
+class LicmPass : public Pass {
+public:
+    string name() const override { return "licm"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"temp-reuse", "print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t moved = 0, loops = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (!unit.is_function() || !unit.single_assignment()) continue;
+            LoopInvariantMotion licm(unit, ctx.tac);
+            for_each_loop_inner_first(unit, [&](const Cfg &cfg, uint32_t l) {
+                size_t n = licm.hoist(cfg, l);
+                moved += n;
+                loops += n > 0;
+            });
+        }
+        ctx.outlog << "Loop-invariant code motion: hoisted " << moved << " instructions out of " << loops << " loops"
+                   << endl;
+        return true;
+    }
+};
+
+#endif // TAC_LICM_H
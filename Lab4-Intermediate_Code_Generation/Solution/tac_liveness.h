@@ -0,0 +1,169 @@
+#ifndef TAC_LIVENESS_H
+#define TAC_LIVENESS_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+
+using namespace std;
+
+// Liveness of the temps and local variables of one function.
+//
+// Every temp and local variable has a slot: temps are [0, temps) by number
+// from the unit's temp_base and locals follow in the order of unit.locals. A
+// set of slots is a bit vector of words() words, and live_in and live_out hold
+// one set per block. Global variables have no slot: a call may read them and
+// they outlive the function, so they count as live everywhere. Arrays have no
+// slot either; a store is never dead.
+
+class Liveness {
+private:
+    const TacFunction &unit;
+    const Cfg &cfg;
+    uint32_t num_words;
+
+public:
+    vector<uint64_t> live_in, live_out;
+
+    Liveness(const TacFunction &unit, const Cfg &cfg)
+        : unit(unit), cfg(cfg), num_words((unit.temps + unit.locals.size() + 63) / 64) {}
+
+    uint32_t words() const { return num_words; }
+    uint32_t slots() const { return unit.temps + unit.locals.size(); }
+
+    // The slot of a temp or local variable, -1 for anything else
+    int32_t slot(const Operand &o) const {
+        if (o.is_temp()) return o.id - unit.temp_base;
+        if (o.kind != OperandKind::VAR) return -1;
+        auto it = lower_bound(unit.locals.begin(), unit.locals.end(), o.id);
+        if (it == unit.locals.end() || *it != o.id) return -1;
+        return unit.temps + (it - unit.locals.begin());
+    }
+
+    static bool test(const uint64_t *set, int32_t s) { return s >= 0 && (set[s >> 6] >> (s & 63) & 1); }
+    static void add(uint64_t *set, int32_t s) {
+        if (s >= 0) set[s >> 6] |= 1ull << (s & 63);
+    }
+    static void remove(uint64_t *set, int32_t s) {
+        if (s >= 0) set[s >> 6] &= ~(1ull << (s & 63));
+    }
+
+    // Calls f on each slot in a set, in increasing order
+    template <class F>
+    void for_each_slot(const uint64_t *set, F f) const {
+        for (uint32_t j = 0; j < num_words; j++) {
+            for (uint64_t bits = set[j]; bits; bits &= bits - 1) f((int32_t)(j * 64 + __builtin_ctzll(bits)));
+        }
+    }
+
+    // Moves live, the set after q, to the set before it
+    void step_back(const Quad &q, uint64_t *live) const {
+        remove(live, slot(defined(q)));
+        for_each_use(q, [&](const Operand &o) { add(live, slot(o)); });
+    }
+
+    void compute() {
+        uint32_t n = cfg.num_blocks(), w = num_words;
+        // the slots each block reads before assigning (gen) and assigns (kill)
+        vector<uint64_t> gen(n * w, 0), kill(n * w, 0);
+        for (uint32_t b = 0; b < n; b++) {
+            uint64_t *g = &gen[b * w], *k = &kill[b * w];
+            for (uint32_t i = cfg.start[b + 1]; i-- > cfg.start[b];) {
+                const Quad &q = unit.code[i];
+                int32_t d = slot(defined(q));
+                if (d >= 0) {
+                    add(k, d);
+                    remove(g, d);
+                }
+                for_each_use(q, [&](const Operand &o) { add(g, slot(o)); });
+            }
+        }
+
+        live_in.assign(n * w, 0);
+        live_out.assign(n * w, 0);
+        // backward problem: postorder converges fastest; unreachable blocks go last
+        vector<uint32_t> order(cfg.rpo.rbegin(), cfg.rpo.rend());
+        for (uint32_t b = 0; b < n; b++) {
+            if (!cfg.reachable(b)) order.push_back(b);
+        }
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (uint32_t b : order) {
+                uint64_t *out = &live_out[b * w], *in = &live_in[b * w];
+                for (uint32_t i = 0; i < 2 && cfg.succs[2 * b + i] != NO_BLOCK; i++) {
+                    const uint64_t *s = &live_in[cfg.succs[2 * b + i] * w];
+                    for (uint32_t j = 0; j < w; j++) out[j] |= s[j];
+                }
+                for (uint32_t j = 0; j < w; j++) {
+                    uint64_t v = gen[b * w + j] | (out[j] & ~kill[b * w + j]);
+                    if (v != in[j]) {
+                        in[j] = v;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+};
+
+// Whether a quad has no effect but its result
+inline bool is_pure(Opcode op) {
+    return op == Opcode::MOV || op == Opcode::LOAD || is_binary(op) || is_unary(op);
+}
+
+// Removes the quads without side effects whose result is never read, until
+// none is left. Returns the number removed.
+inline size_t eliminate_dead_code(TacFunction &unit) {
+    size_t removed = 0;
+    vector<uint8_t> dead;
+    vector<uint64_t> live;
+    for (;;) {
+        Cfg cfg = build_cfg(unit);
+        Liveness liveness(unit, cfg);
+        liveness.compute();
+        uint32_t w = liveness.words();
+        dead.assign(unit.code.size(), 0);
+        size_t found = 0;
+        for (uint32_t b = 0; b < cfg.num_blocks(); b++) {
+            live.assign(&liveness.live_out[b * w], &liveness.live_out[b * w] + w);
+            for (uint32_t i = cfg.start[b + 1]; i-- > cfg.start[b];) {
+                const Quad &q = unit.code[i];
+                int32_t d = liveness.slot(defined(q));
+                if (is_pure(q.op) && d >= 0 && !Liveness::test(live.data(), d)) {
+                    dead[i] = 1;
+                    found++;
+                    continue;
+                }
+                liveness.step_back(q, live.data());
+            }
+        }
+        if (!found) break;
+        size_t kept = 0;
+        for (size_t i = 0; i < unit.code.size(); i++) {
+            if (!dead[i]) unit.code[kept++] = unit.code[i];
+        }
+        unit.code.resize(kept);
+        removed += found;
+    }
+    return removed;
+}
+
+// Dead code elimination on every function (-O1)
+class DeadCodePass : public Pass {
+public:
+    string name() const override { return "dce"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t removed = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (unit.is_function() && unit.single_assignment()) removed += eliminate_dead_code(unit);
+        }
+        ctx.outlog << "Dead code: removed " << removed << " instructions" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_LIVENESS_H
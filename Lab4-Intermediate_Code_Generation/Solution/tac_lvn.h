@@ -0,0 +1,213 @@
+#ifndef TAC_LVN_H
+#define TAC_LVN_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+
+#include <unordered_map>
+
+using namespace std;
+
+// Local value numbering over the basic blocks of each function.
+//
+// Within a block every value gets a number: a constant by its literal, a
+// variable by what was last loaded from or assigned to it, an operation by its
+// opcode and operand numbers (sorted for the commutative ones) and an array
+// element by the array, the offset's number and the array's version. A quad
+// whose value already has a number is dropped and its temp replaced by the one
+// that first held the value; an assignment of the value a variable already
+// holds is dropped too.
+//
+// An assignment to a variable gives it the number of the assigned value, and a
+// store to an array gives the array a new version, so no load of it from before
+// the store is reused. A call may change any global variable or array, so it
+// forgets every variable and version. Nothing is carried from one block to the
+// next.
+//
+// Temps are assigned once by the code generator, so a temp that holds a value
+// does so everywhere after its definition; a unit where some temp is assigned
+// twice is left alone. Operands and destinations may be variables and
+// immediates as well as temps, so the pass also works on optimized code.
+
+class LocalValueNumbering {
+private:
+    struct Key {
+        Opcode op;
+        uint32_t x, y, z;
+        bool operator==(const Key &k) const { return op == k.op && x == k.x && y == k.y && z == k.z; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            uint64_t h = (uint64_t)k.op * 0x9e3779b97f4a7c15ull;
+            h = (h ^ k.x) * 0x100000001b3ull;
+            h = (h ^ k.y) * 0x100000001b3ull;
+            h = (h ^ k.z) * 0x100000001b3ull;
+            return h ^ (h >> 29);
+        }
+    };
+
+    // A table entry only counts if it was made in the current epoch or later, so
+    // forgetting a table is starting an epoch rather than clearing it
+    struct Entry {
+        uint32_t epoch, vn;
+    };
+
+    TacFunction *unit = nullptr;
+    uint32_t next_vn = 0;
+    uint32_t epoch = 0, block_epoch = 0, memory_epoch = 0;
+    vector<uint32_t> temp_vn;                 // temp - temp_base -> number, NO_BLOCK if not numbered
+    vector<int32_t> rename;                   // temp - temp_base -> temp that replaces it, -1 if none
+    vector<Operand> holder;                   // number -> temp holding the value
+    unordered_map<Key, Entry, KeyHash> values;
+    unordered_map<int32_t, Entry> var_vn, version; // by the string id of the variable or array
+
+    uint32_t fresh(Operand h) {
+        holder.push_back(h);
+        return next_vn++;
+    }
+
+    Operand resolve(Operand o) {
+        if (o.is_temp() && rename[o.id - unit->temp_base] >= 0) o.id = rename[o.id - unit->temp_base];
+        return o;
+    }
+
+    // The entry for key in table, made anew unless it is from since the given epoch
+    template <class Table, class K>
+    uint32_t find(Table &table, const K &key, uint32_t since) {
+        Entry &e = table[key];
+        if (e.epoch < since) e = {epoch, fresh(Operand())};
+        return e.vn;
+    }
+
+    uint32_t lookup(const Key &k) { return find(values, k, block_epoch); }
+    uint32_t array_version(int32_t array) { return find(version, array, memory_epoch); }
+
+    // Number of the value of an operand; a temp from another block starts a new value
+    uint32_t vn_of(Operand o) {
+        if (o.kind == OperandKind::VAR) return find(var_vn, o.id, memory_epoch);
+        if (o.kind == OperandKind::IMM) return lookup({Opcode::MOV, (uint32_t)o.id, 0, 0});
+        uint32_t &vn = temp_vn[o.id - unit->temp_base];
+        if (vn == NO_BLOCK) vn = fresh(o);
+        return vn;
+    }
+
+    // Gives q.dst the value vn. Returns true if q.dst is a temp and another temp
+    // already holds the value, which then stands in for it.
+    bool redundant(const Quad &q, uint32_t vn) {
+        if (q.dst.kind == OperandKind::VAR) {
+            var_vn[q.dst.id] = {epoch, vn};
+            return false;
+        }
+        if (!holder[vn]) holder[vn] = q.dst;
+        temp_vn[q.dst.id - unit->temp_base] = vn;
+        if (holder[vn] == q.dst) return false;
+        rename[q.dst.id - unit->temp_base] = holder[vn].id;
+        return true;
+    }
+
+    void start_block() { block_epoch = memory_epoch = ++epoch; }
+
+    static bool commutative(Opcode op) {
+        return op == Opcode::ADD || op == Opcode::MUL || op == Opcode::EQ || op == Opcode::NE ||
+               op == Opcode::AND || op == Opcode::OR;
+    }
+
+    // Whether the quad can be dropped; renames its operands either way
+    bool number(Quad &q) {
+        q.a = resolve(q.a);
+        q.b = resolve(q.b);
+        switch (q.op) {
+        case Opcode::MOV:
+            if (q.dst.kind == OperandKind::VAR) {
+                uint32_t vn = vn_of(q.a);
+                Entry &e = var_vn[q.dst.id];
+                if (e.epoch >= memory_epoch && e.vn == vn) {
+                    stores++;
+                    return true;
+                }
+                e = {epoch, vn};
+                return false;
+            }
+            if (!redundant(q, vn_of(q.a))) return false;
+            (q.a.kind == OperandKind::IMM ? constants : loads)++;
+            return true;
+        case Opcode::LOAD: {
+            Key element = {Opcode::LOAD, (uint32_t)q.a.id, vn_of(q.b), array_version(q.a.id)};
+            return redundant(q, lookup(element)) && ++loads;
+        }
+        case Opcode::STORE: {
+            uint32_t v = fresh(Operand());
+            version[q.dst.id] = {epoch, v};
+            // a load of the element just stored is the stored value
+            values[{Opcode::LOAD, (uint32_t)q.dst.id, vn_of(q.a), v}] = {epoch, vn_of(q.b)};
+            return false;
+        }
+        case Opcode::CALL:
+            memory_epoch = ++epoch;
+            if (q.dst.kind == OperandKind::VAR) var_vn[q.dst.id] = {epoch, fresh(Operand())};
+            return false;
+        default:
+            break;
+        }
+        if (is_binary(q.op) && q.a && q.b) {
+            uint32_t x = vn_of(q.a), y = vn_of(q.b);
+            if (commutative(q.op) && x > y) swap(x, y);
+            return redundant(q, lookup({q.op, x, y, 0})) && ++expressions;
+        }
+        if (is_unary(q.op) && q.a) return redundant(q, lookup({q.op, vn_of(q.a), 0, 0})) && ++expressions;
+        return false;
+    }
+
+public:
+    size_t loads = 0, constants = 0, stores = 0, expressions = 0;
+
+    // Numbers the blocks of one unit; returns false if it was left alone
+    bool run(TacFunction &function) {
+        unit = &function;
+        if (!unit->single_assignment()) return false;
+        temp_vn.assign(unit->temps, NO_BLOCK);
+        rename.assign(unit->temps, -1);
+        holder.clear();
+        next_vn = 0;
+        values.clear();
+        var_vn.clear();
+        version.clear();
+        start_block();
+        size_t kept = 0;
+        for (size_t i = 0; i < unit->code.size(); i++) {
+            Quad q = unit->code[i];
+            if (q.op == Opcode::LABEL) start_block();
+            if (!number(q)) unit->code[kept++] = q;
+            if (ends_block(q.op)) start_block();
+        }
+        unit->code.resize(kept);
+        return true;
+    }
+};
+
+// Value numbering of every function's blocks (-O1)
+class LvnPass : public Pass {
+public:
+    string name() const override { return "lvn"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        LocalValueNumbering lvn;
+        size_t skipped = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (unit.is_function() && !lvn.run(unit)) skipped++;
+        }
+        ctx.outlog << "Value numbering: removed " << lvn.loads << " redundant loads, " << lvn.constants
+                   << " repeated constants, " << lvn.expressions << " common subexpressions, " << lvn.stores
+                   << " redundant assignments";
+        if (skipped) ctx.outlog << "; " << skipped << " functions left alone";
+        ctx.outlog << endl;
+        return true;
+    }
+};
+
+#endif // TAC_LVN_H
@@ -0,0 +1,343 @@
+#ifndef TAC_STRENGTH_H
+#define TAC_STRENGTH_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+#include "tac_liveness.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+// Strength reduction of induction variables in array addressing.
+//
+// A basic induction variable of a loop is a local variable that the loop only
+// assigns as i = i + c or i = i - c with c a constant, directly or through a
+// temp: t = i + c; i = t. For each i * s in the loop with s a constant, a new
+// temp p is set to i * s in the preheader and increased by c * s right after
+// each assignment of i, so p equals i * s everywhere in the loop and the
+// multiply becomes a read of p. Where the product is only read later in its
+// block before p changes, its reads use p directly and the copy goes.
+//
+// If the loop then reads i only to step it and to test it against a loop-
+// invariant bound n, with s positive, and i is dead on leaving the loop, the
+// tests compare p with n * s instead and i is no longer kept. p is assigned
+// more than once, so this runs after every pass that needs temps assigned once.
+
+class StrengthReduction {
+private:
+    struct Step {
+        uint32_t at;   // the assignment of i
+        uint32_t temp; // index of t = i + c when i = t, NO_BLOCK for i = i + c
+        long long c;
+    };
+
+    struct Product {
+        uint32_t at;
+        long long s;
+    };
+
+    TacFunction &unit;
+    TacProgram &program;
+    vector<uint32_t> block_of;   // quad index -> block
+    vector<uint8_t> in_loop;     // block -> in the loop
+    vector<uint32_t> def_at;     // temp - temp_base -> its definition, NO_BLOCK if none or several
+    vector<uint32_t> reads;      // temp - temp_base -> times read
+    bool calls = false;
+
+    // quads to drop, to add after a quad, and to add to the preheader
+    vector<uint8_t> dropped;
+    vector<vector<Quad>> after;
+    vector<Quad> preheader;
+
+    bool integer(const Operand &o, long long &v) const {
+        if (o.kind != OperandKind::IMM) return false;
+        const string &text = program.str(o);
+        char *end;
+        v = strtoll(text.c_str(), &end, 10);
+        return !*end;
+    }
+
+    bool loop_quad(uint32_t i) const { return in_loop[block_of[i]]; }
+
+    // The step of i = i + c or i = i - c, with i in x and the constant in y
+    bool step_of(const Quad &q, const Operand &i, long long &c) const {
+        if (q.op == Opcode::ADD) {
+            if (q.a == i && integer(q.b, c)) return true;
+            return q.b == i && integer(q.a, c);
+        }
+        if (q.op == Opcode::SUB && q.a == i && integer(q.b, c)) {
+            c = -c;
+            return true;
+        }
+        return false;
+    }
+
+    // The steps of i in the loop, false if it is assigned any other way
+    bool find_steps(const Operand &i, const vector<uint32_t> &quads, vector<Step> &steps) const {
+        for (uint32_t k : quads) {
+            const Quad &q = unit.code[k];
+            if (defined(q) != i) continue;
+            long long c;
+            if (step_of(q, i, c)) {
+                steps.push_back({k, NO_BLOCK, c});
+                continue;
+            }
+            if (q.op != Opcode::MOV || !q.a.is_temp()) return false;
+            uint32_t d = def_at[q.a.id - unit.temp_base];
+            if (d == NO_BLOCK || d > k || block_of[d] != block_of[k] || !step_of(unit.code[d], i, c)) return false;
+            for (uint32_t j = d + 1; j < k; j++) {
+                if (defined(unit.code[j]) == i) return false;
+            }
+            steps.push_back({k, d, c});
+        }
+        return !steps.empty();
+    }
+
+    bool invariant(const Operand &o, const vector<int32_t> &assigned) const {
+        if (o.kind == OperandKind::IMM) return true;
+        if (o.kind == OperandKind::VAR) {
+            return !binary_search(assigned.begin(), assigned.end(), o.id) && !(calls && !unit.is_local(o));
+        }
+        if (!o.is_temp()) return false;
+        uint32_t d = def_at[o.id - unit.temp_base];
+        return d != NO_BLOCK && !loop_quad(d);
+    }
+
+    // Replaces reads of the product t = p later in its block, until p changes;
+    // true if that was every read of t
+    bool forward(uint32_t at, const Operand &p, const vector<Step> &steps) {
+        Operand t = unit.code[at].dst;
+        uint32_t replaced = 0, end = at + 1;
+        while (end < unit.code.size() && block_of[end] == block_of[at]) end++;
+        for (uint32_t j = at + 1; j < end; j++) {
+            for_each_use(unit.code[j], [&](Operand &o) {
+                if (o == t) {
+                    o = p;
+                    replaced++;
+                }
+            });
+            bool steps_here = false;
+            for (const Step &st : steps) steps_here |= st.at == j;
+            if (steps_here) break;
+        }
+        return replaced == reads[t.id - unit.temp_base];
+    }
+
+    static bool is_step_temp(const Operand &o, const vector<Step> &steps, const vector<Quad> &code) {
+        for (const Step &st : steps) {
+            if (st.temp != NO_BLOCK && code[st.temp].dst == o) return true;
+        }
+        return false;
+    }
+
+    // Whether the loop reads i, and the temps of its steps, only to step i and
+    // in tests against invariant bounds; collects those tests with the side
+    // of the counter, 0 for a and 1 for b
+    bool only_counts(const Operand &i, const vector<uint32_t> &quads, const vector<Step> &steps,
+                     const vector<int32_t> &assigned, vector<pair<uint32_t, int>> &tests) const {
+        auto counter = [&](const Operand &o) { return o == i || is_step_temp(o, steps, unit.code); };
+        for (uint32_t k : quads) {
+            const Quad &q = unit.code[k];
+            bool reads = false;
+            for_each_use(q, [&](const Operand &o) { reads |= counter(o); });
+            if (!reads) continue;
+            bool stepping = false;
+            for (const Step &st : steps) stepping |= st.at == k || st.temp == k;
+            if (stepping) continue;
+            if (!is_branch(q.op) || counter(q.a) == counter(q.b)) return false;
+            int side = counter(q.a) ? 0 : 1;
+            const Operand &c = side ? q.b : q.a;
+            if (!invariant(side ? q.a : q.b, assigned)) return false;
+            // a step's temp holds i only after the step, later in its block
+            if (c != i) {
+                bool after_step = false;
+                for (const Step &st : steps) {
+                    if (st.temp != NO_BLOCK && unit.code[st.temp].dst == c) {
+                        after_step |= block_of[st.at] == block_of[k] && st.at < k;
+                    }
+                }
+                if (!after_step) return false;
+            }
+            tests.push_back({k, side});
+        }
+        return true;
+    }
+
+    // The local variables live where control leaves the loop
+    vector<int32_t> live_on_exit(const Cfg &cfg) const {
+        Liveness liveness(unit, cfg);
+        liveness.compute();
+        vector<int32_t> live;
+        for (uint32_t b = 0; b < cfg.num_blocks(); b++) {
+            for (uint32_t k = 0; in_loop[b] && k < 2; k++) {
+                uint32_t s = cfg.succs[2 * b + k];
+                if (s == NO_BLOCK || in_loop[s]) continue;
+                for (size_t v = 0; v < unit.locals.size(); v++) {
+                    if (Liveness::test(&liveness.live_in[s * liveness.words()], unit.temps + v)) {
+                        live.push_back(unit.locals[v]);
+                    }
+                }
+            }
+        }
+        sort(live.begin(), live.end());
+        return live;
+    }
+
+public:
+    size_t products = 0, variables = 0, counters = 0;
+
+    StrengthReduction(TacFunction &unit, TacProgram &program) : unit(unit), program(program) {}
+
+    void reduce(const Cfg &cfg, uint32_t l) {
+        if (!has_preheader(unit, cfg, l)) return;
+        const CfgLoop &loop = cfg.loops[l];
+        uint32_t n = cfg.num_blocks(), size = unit.code.size();
+        in_loop.assign(n, 0);
+        for (uint32_t k = loop.first; k < loop.first + loop.count; k++) in_loop[cfg.loop_blocks[k]] = 1;
+        block_of.resize(size);
+        def_at.assign(unit.temps, NO_BLOCK);
+        reads.assign(unit.temps, 0);
+        vector<uint8_t> defs(unit.temps, 0);
+        vector<int32_t> assigned;
+        vector<uint32_t> quads; // of the loop, in code order
+        calls = false;
+        for (uint32_t b = 0; b < n; b++) {
+            for (uint32_t k = cfg.start[b]; k < cfg.start[b + 1]; k++) {
+                const Quad &q = unit.code[k];
+                block_of[k] = b;
+                Operand d = defined(q);
+                if (d.is_temp() && defs[d.id - unit.temp_base]++ == 0) def_at[d.id - unit.temp_base] = k;
+                if (d.is_temp() && defs[d.id - unit.temp_base] > 1) def_at[d.id - unit.temp_base] = NO_BLOCK;
+                for_each_use(q, [&](const Operand &o) {
+                    if (o.is_temp()) reads[o.id - unit.temp_base]++;
+                });
+                if (!in_loop[b]) continue;
+                quads.push_back(k);
+                if (d.kind == OperandKind::VAR) assigned.push_back(d.id);
+                if (q.op == Opcode::CALL) calls = true;
+            }
+        }
+        sort(assigned.begin(), assigned.end());
+
+        // the products of a local variable and a constant, by variable
+        vector<pair<int32_t, Product>> found;
+        for (uint32_t k : quads) {
+            const Quad &q = unit.code[k];
+            long long s;
+            if (q.op != Opcode::MUL) continue;
+            if (q.a.kind == OperandKind::VAR && unit.is_local(q.a) && integer(q.b, s)) found.push_back({q.a.id, {k, s}});
+            else if (q.b.kind == OperandKind::VAR && unit.is_local(q.b) && integer(q.a, s)) found.push_back({q.b.id, {k, s}});
+        }
+        if (found.empty()) return;
+        stable_sort(found.begin(), found.end(), [](auto &x, auto &y) { return x.first < y.first; });
+
+        dropped.assign(size, 0);
+        after.assign(size, {});
+        preheader.clear();
+        vector<int32_t> exit_live = live_on_exit(cfg); // before new temps move the slots of the locals
+        for (size_t f = 0; f < found.size();) {
+            Operand i = {OperandKind::VAR, found[f].first};
+            size_t g = f;
+            while (g < found.size() && found[g].first == i.id) g++;
+            vector<Step> steps;
+            if (!find_steps(i, quads, steps)) {
+                f = g;
+                continue;
+            }
+            variables++;
+
+            // one temp per scale, set before the loop and stepped with i
+            vector<pair<long long, Operand>> scaled;
+            for (size_t k = f; k < g; k++) {
+                Product pr = found[k].second;
+                Operand p;
+                for (auto &sp : scaled) {
+                    if (sp.first == pr.s) p = sp.second;
+                }
+                if (!p) {
+                    p = unit.new_temp();
+                    def_at.push_back(NO_BLOCK);
+                    reads.push_back(0);
+                    scaled.push_back({pr.s, p});
+                    preheader.push_back({Opcode::MUL, p, i, program.imm(pr.s)});
+                    for (const Step &st : steps) {
+                        long long d = st.c * pr.s;
+                        after[st.at].push_back({d < 0 ? Opcode::SUB : Opcode::ADD, p, p, program.imm(d < 0 ? -d : d)});
+                    }
+                }
+                Quad &q = unit.code[pr.at];
+                q = {Opcode::MOV, q.dst, p, Operand()};
+                if (q.dst.is_temp() && forward(pr.at, p, steps)) dropped[pr.at] = 1;
+                products++;
+            }
+            f = g;
+
+            // the counter itself goes if only its tests need it
+            long long s = scaled[0].first;
+            Operand p = scaled[0].second;
+            vector<pair<uint32_t, int>> tests;
+            if (s <= 0 || binary_search(exit_live.begin(), exit_live.end(), i.id)) continue;
+            if (!only_counts(i, quads, steps, assigned, tests)) continue;
+            for (auto [k, side] : tests) {
+                Quad &q = unit.code[k];
+                Operand &bound = side ? q.a : q.b;
+                long long v;
+                if (integer(bound, v)) {
+                    bound = program.imm(v * s);
+                } else {
+                    Operand scaled_bound = unit.new_temp();
+                    preheader.push_back({Opcode::MUL, scaled_bound, bound, program.imm(s)});
+                    bound = scaled_bound;
+                }
+                (side ? q.b : q.a) = p;
+            }
+            for (const Step &st : steps) {
+                dropped[st.at] = 1;
+                if (st.temp != NO_BLOCK) dropped[st.temp] = 1;
+            }
+            counters++;
+        }
+        if (preheader.empty()) return;
+
+        vector<Quad> code;
+        code.reserve(size + preheader.size() + 8);
+        uint32_t at = cfg.start[loop.header];
+        for (uint32_t k = 0; k < size; k++) {
+            if (k == at) code.insert(code.end(), preheader.begin(), preheader.end());
+            if (!dropped[k]) code.push_back(unit.code[k]);
+            code.insert(code.end(), after[k].begin(), after[k].end());
+        }
+        unit.code.swap(code);
+    }
+};
+
+// Strength reduction of every function's loops (-O1)
+class StrengthReductionPass : public Pass {
+public:
+    string name() const override { return "strength-reduce"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"temp-reuse", "print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t products = 0, variables = 0, counters = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (!unit.is_function() || !unit.single_assignment()) continue;
+            if (none_of(unit.code.begin(), unit.code.end(), [](const Quad &q) { return q.op == Opcode::MUL; })) continue;
+            StrengthReduction reduction(unit, ctx.tac);
+            for_each_loop_inner_first(unit, [&](const Cfg &cfg, uint32_t l) { reduction.reduce(cfg, l); });
+            if (reduction.counters) eliminate_dead_code(unit);
+            products += reduction.products;
+            variables += reduction.variables;
+            counters += reduction.counters;
+        }
+        ctx.outlog << "Strength reduction: " << products << " multiplications by " << variables
+                   << " induction variables replaced, " << counters << " loop counters eliminated" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_STRENGTH_H
@@ -0,0 +1,144 @@
+#ifndef TAC_TEMP_REUSE_H
+#define TAC_TEMP_REUSE_H
+
+#include "pass_manager.h"
+#include "tac_cfg.h"
+#include "tac_ir.h"
+#include "tac_liveness.h"
+
+#include <algorithm>
+#include <queue>
+
+using namespace std;
+
+// Renumbers the temps of each function onto as few names as possible.
+//
+// The code generator numbers temps across the whole program and never reuses
+// one. After optimization each temp gets a live interval over the function's
+// code in order: from its definition, or the start of a block it is live into,
+// to its last read, or the end of a block it is live out of. Quad i reads at
+// point 2i and writes at 2i + 1, so the temp a quad reads last can be the one
+// it writes. Linear scan then hands out names in order of interval start,
+// taking the smallest free one; a name is free again once its interval has
+// ended. That uses as many names as the most intervals overlapping at one
+// point, t0 .. tk-1 in every function. A temp assigned more than once, as
+// strength reduction makes them, gets one interval over all its assignments.
+//
+// Temps are no longer assigned once afterwards, so this runs after every other
+// pass on the IR.
+
+class TempReuse {
+private:
+    struct Interval {
+        uint32_t start, end;
+        int32_t temp;
+    };
+
+    TacFunction &unit;
+    vector<Interval> intervals; // by temp - temp_base, start UINT32_MAX if never seen
+
+    void extend(int32_t slot, uint32_t point) {
+        Interval &v = intervals[slot];
+        v.start = min(v.start, point);
+        v.end = max(v.end, point);
+    }
+
+    void find_intervals() {
+        Cfg cfg = build_cfg(unit);
+        Liveness liveness(unit, cfg);
+        liveness.compute();
+        uint32_t w = liveness.words();
+        intervals.resize(unit.temps);
+        for (int32_t t = 0; t < unit.temps; t++) intervals[t] = {UINT32_MAX, 0, t};
+        for (uint32_t b = 0; b < cfg.num_blocks(); b++) {
+            uint32_t first = cfg.start[b], last = cfg.start[b + 1] - 1;
+            liveness.for_each_slot(&liveness.live_in[b * w], [&](int32_t s) {
+                if (s < unit.temps) extend(s, 2 * first);
+            });
+            liveness.for_each_slot(&liveness.live_out[b * w], [&](int32_t s) {
+                if (s < unit.temps) extend(s, 2 * last + 1);
+            });
+        }
+        for (uint32_t i = 0; i < unit.code.size(); i++) {
+            const Quad &q = unit.code[i];
+            for_each_use(q, [&](const Operand &o) {
+                if (o.is_temp()) extend(o.id - unit.temp_base, 2 * i);
+            });
+            if (q.dst.is_temp()) extend(q.dst.id - unit.temp_base, 2 * i + 1);
+        }
+    }
+
+public:
+    int32_t names = 0;
+    size_t renamed = 0;
+
+    explicit TempReuse(TacFunction &unit) : unit(unit) {}
+
+    void run() {
+        find_intervals();
+        vector<int32_t> name(unit.temps, -1);
+        vector<Interval> order;
+        for (const Interval &v : intervals) {
+            if (v.start != UINT32_MAX) order.push_back(v);
+        }
+        sort(order.begin(), order.end(), [](const Interval &x, const Interval &y) { return x.start < y.start; });
+
+        // active intervals by end, earliest first; freed names, smallest first
+        priority_queue<pair<uint32_t, int32_t>, vector<pair<uint32_t, int32_t>>, greater<>> active;
+        priority_queue<int32_t, vector<int32_t>, greater<>> free_names;
+        for (const Interval &v : order) {
+            while (!active.empty() && active.top().first < v.start) {
+                free_names.push(active.top().second);
+                active.pop();
+            }
+            int32_t n;
+            if (free_names.empty()) {
+                n = names++;
+            } else {
+                n = free_names.top();
+                free_names.pop();
+            }
+            name[v.temp] = n;
+            renamed++;
+            active.push({v.end, n});
+        }
+
+        auto rename = [&](Operand &o) {
+            if (o.is_temp()) o.id = name[o.id - unit.temp_base];
+        };
+        for (Quad &q : unit.code) {
+            rename(q.dst);
+            rename(q.a);
+            rename(q.b);
+        }
+        unit.temp_base = 0;
+        unit.temps = names;
+    }
+};
+
+// Temp reuse in every function (-O1), the last pass before printing
+class TempReusePass : public Pass {
+public:
+    string name() const override { return "temp-reuse"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+    vector<string> run_before() const override { return {"print-tac"}; }
+    int min_opt_level() const override { return 1; }
+
+    bool run(PassContext &ctx) override {
+        size_t before = 0, after = 0;
+        int32_t most = 0;
+        for (TacFunction &unit : ctx.tac.units) {
+            if (!unit.is_function() || !unit.own_temps()) continue;
+            TempReuse reuse(unit);
+            reuse.run();
+            before += reuse.renamed;
+            after += reuse.names;
+            most = max(most, reuse.names);
+        }
+        ctx.outlog << "Temp reuse: " << before << " temps renamed onto " << after << " names, at most " << most
+                   << " in one function" << endl;
+        return true;
+    }
+};
+
+#endif // TAC_TEMP_REUSE_H
@@ -2,46 +2,466 @@
 #define THREE_ADDR_CODE_H
 
 #include "ast.h"
+#include "ast_visitor.h"
+#include "emitter.h"
+#include "pass_manager.h"
+#include "tac_cache.h"
+#include "tac_ir.h"
+#include <algorithm>
 #include <fstream>
 #include <string>
-#include <map>
 
 using namespace std;
 
-class ThreeAddrCodeGenerator {
+// Builds the three-address code of the AST as a TacProgram (see tac_ir.h).
+// Each visit returns the temp holding the value of an expression, or no temp
+// for statements.
+
+class ThreeAddrCodeGenerator : public ASTVisitor<Temp> {
 private:
-    ProgramNode* ast_root;
-    ofstream& outcode;
-    map<string, string> symbol_to_temp;
+    TacProgram& program;
     int temp_count;
     int label_count;
+    bool in_function = false;
+    vector<Quad> body;                    // code of the function being generated, reused so it grows once
+    vector<int32_t> names;                // AST string id -> program string id, -1 if not interned yet
+    vector<Opcode> binary_ops, unary_ops; // AST string id of an operator -> opcode, COUNT if not looked up yet
+    Operand scales[2];                    // the element sizes, 4 and 8
+    vector<bool> global_names;            // AST string id -> declared at global scope
+
+    Temp new_temp() { return Temp{temp_count++}; }
+    int new_label() { return label_count++; }
+
+    Operand name(OperandKind kind, str_id s) {
+        if (s >= names.size()) names.resize(s + 1, -1);
+        if (names[s] < 0) names[s] = program.intern(ast.str(s));
+        return {kind, names[s]};
+    }
+
+    Opcode opcode(vector<Opcode>& ops, Opcode (*lookup)(string_view), str_id op) {
+        if (op >= ops.size()) ops.resize(op + 1, Opcode::COUNT);
+        if (ops[op] == Opcode::COUNT) ops[op] = lookup(ast.str(op));
+        return ops[op];
+    }
+
+    Operand scale(uint32_t size) {
+        Operand& s = scales[size == 8];
+        if (!s) s = program.imm(size);
+        return s;
+    }
+
+    // Global declarations between functions share a unit
+    void emit(Opcode op, Operand dst, Operand a = Operand(), Operand b = Operand()) {
+        if (in_function) {
+            body.push_back({op, dst, a, b});
+            return;
+        }
+        if (program.units.empty() || program.units.back().is_function()) {
+            program.units.emplace_back();
+            program.units.back().temp_base = temp_count;
+            program.units.back().label_base = label_count;
+        }
+        program.units.back().code.push_back({op, dst, a, b});
+    }
+
+    void emit(Opcode op, Temp dst, Operand a = Operand(), Operand b = Operand()) { emit(op, Operand::temp(dst), a, b); }
+    void emit_label(Opcode op, int l) { emit(op, Operand(), Operand::label(l)); }
+    void comment(string text) { emit(Opcode::COMMENT, Operand(), program.text(std::move(text))); }
+
+    void add_local(str_id v, TacFunction& fn) {
+        if (v < global_names.size() && global_names[v]) fn.shadows_global = true;
+        else fn.locals.push_back(name(OperandKind::VAR, v).id);
+    }
+
+    void add_declared(node_id id, TacFunction& fn) {
+        if (ast.kind(id) == NodeKind::DECL) {
+            const DeclNode& d = ast.decl(id);
+            for (uint32_t i = 0; i < d.num_vars; i++) add_local(ast.decl_var(d, i).name, fn);
+        }
+        ast.for_each_child(id, [&](node_id c) { add_declared(c, fn); });
+    }
+
+    // Records the parameters and local variables of a function in its unit
+    void set_variables(node_id func, TacFunction& fn) {
+        const FuncDeclNode& f = ast.func_decl(func);
+        fn.locals.clear();
+        fn.params.clear();
+        for (uint32_t i = 0; i < f.num_params; i++) {
+            str_id p = ast.param(f, i).name;
+            fn.params.push_back(name(OperandKind::VAR, p).id);
+            add_local(p, fn);
+        }
+        if (f.body) add_declared(f.body, fn);
+        sort(fn.locals.begin(), fn.locals.end());
+        fn.locals.erase(unique(fn.locals.begin(), fn.locals.end()), fn.locals.end());
+    }
+
+    Temp generate_index_code(const VarNode& v, const string& type) {
+        // Calculate the array offset and return the temp holding it
+        if (!v.index) return Temp();
+        Temp index_temp = visit(v.index);
+        Temp scale_temp = new_temp();
+        emit(Opcode::MOV, scale_temp, scale(element_size(type)));
+        Temp offset_temp = new_temp();
+        emit(Opcode::MUL, offset_temp, Operand::temp(index_temp), Operand::temp(scale_temp));
+        return offset_temp;
+    }
 
 public:
-    ThreeAddrCodeGenerator(ProgramNode* root, ofstream& out)
-        : ast_root(root), outcode(out), temp_count(0), label_count(0) {}
+    ThreeAddrCodeGenerator(const ASTArena& ast, TacProgram& program)
+        : ASTVisitor(ast), program(program), temp_count(0), label_count(0) {}
 
-    void generate() {
-        // TODO: Implement this method
-        // This method should:
-        // 1. Write a header to the output file
-        // 2. Call the generate_code method of the AST root
-        // 3. Write a footer to the output file
-        outcode << "//========== THREE ADDRESS CODE ==========" << endl << endl;
-        outcode << "// This code was generated by a two-pass compiler" << endl;
-        outcode << "// Format:" << endl;
-        outcode << "// - t0, t1, etc. are temporary variables" << endl;
-        outcode << "// - L0, L1, etc. are labels for jumps" << endl;
-        outcode << "// - Operations follow the three-address code format" << endl << endl;
-        outcode << "// Three Address Code" << endl << endl;
+    void generate(node_id root, TacCache* cache = nullptr) {
+        if (root && cache) {
+            generate_cached(root, *cache);
+        } else if (root) {
+            visit(root);
+        }
+    }
+
+    // Generates the program function by function, reusing the code of every
+    // function found in the cache
+    void generate_cached(node_id program_node, TacCache& cache) {
+        ast.for_each(ast.program(program_node).units, [&](node_id unit) {
+            if (ast.kind(unit) != NodeKind::FUNC_DECL) {
+                visit(unit);
+                return;
+            }
+            uint64_t key = cache.key(ast, unit);
+            TacCache::Function f;
+            if (cache.find(key, f)) {
+                program.units.emplace_back();
+                program.units.back().name = name(OperandKind::FUNC, ast.func_decl(unit).name).id;
+                TacBuilder code(program, program.units.size() - 1);
+                TacCache::replay(f, temp_count, label_count, code);
+            } else {
+                // generated on its own, numbered from t0 and L0 as the cache keeps it
+                ThreeAddrCodeGenerator gen(ast, program);
+                gen.visit(unit);
+                TacRecorder code;
+                print_unit(program, program.units.back(), code);
+                f = cache.add(key, std::move(code), gen.temps_used(), gen.labels_used());
+                program.units.back().rebase(temp_count, label_count);
+            }
+            TacFunction& fn = program.units.back();
+            set_variables(unit, fn);
+            fn.temp_base = temp_count;
+            fn.temps = f.temps;
+            fn.label_base = label_count;
+            fn.labels = f.labels;
+            temp_count += f.temps;
+            label_count += f.labels;
+        });
+    }
+
+    int temps_used() const { return temp_count; }
+    int labels_used() const { return label_count; }
+
+    // Expressions
 
-        if (ast_root) {
-            ast_root->generate_code(outcode, symbol_to_temp, temp_count, label_count);
+    Temp visit_var(node_id id) override {
+        // Variable access or array access
+        const VarNode& v = ast.var(id);
+        Temp temp = new_temp();
+        if (v.index) {
+            Temp offset = generate_index_code(v, ast.get_type(id));
+            emit(Opcode::LOAD, temp, name(OperandKind::VAR, v.name), Operand::temp(offset));
+        } else {
+            emit(Opcode::MOV, temp, name(OperandKind::VAR, v.name));
         }
+        return temp;
+    }
+
+    Temp visit_const(node_id id) override {
+        Temp temp = new_temp();
+        emit(Opcode::MOV, temp, name(OperandKind::IMM, ast.constant(id).value));
+        return temp;
+    }
+
+    // The operands of a binary operator, in the order chosen by sethi-ullman
+    pair<Temp, Temp> visit_operands(node_id id) {
+        const BinaryOpNode& b = ast.binary_op(id);
+        Temp lt, rt;
+        if (ast.has_flag(id, RIGHT_FIRST)) {
+            rt = visit(b.right);
+            lt = visit(b.left);
+        } else {
+            lt = visit(b.left);
+            rt = visit(b.right);
+        }
+        return {lt, rt};
+    }
 
-        outcode << endl << "//========== END OF CODE ==========" << endl ;
+    Temp visit_binary_op(node_id id) override {
+        auto [lt, rt] = visit_operands(id);
+        Temp temp = new_temp();
+        emit(opcode(binary_ops, binary_opcode, ast.binary_op(id).op), temp, Operand::temp(lt), Operand::temp(rt));
+        return temp;
     }
 
-    // You may add helper methods here
+    Temp visit_unary_op(node_id id) override {
+        const UnaryOpNode& u = ast.unary_op(id);
+        Temp et = visit(u.expr);
+        Temp temp = new_temp();
+        emit(opcode(unary_ops, unary_opcode, u.op), temp, Operand::temp(et));
+        return temp;
+    }
+
+    Temp visit_assign(node_id id) override {
+        const AssignNode& a = ast.assign(id);
+        const VarNode& lhs = ast.var(a.lhs);
+        Temp right_temp = visit(a.rhs);
+        if (lhs.index) {
+            Temp offset = generate_index_code(lhs, ast.get_type(a.lhs));
+            emit(Opcode::STORE, name(OperandKind::VAR, lhs.name), Operand::temp(offset), Operand::temp(right_temp));
+        } else {
+            emit(Opcode::MOV, name(OperandKind::VAR, lhs.name), Operand::temp(right_temp));
+        }
+        return right_temp;
+    }
+
+    Temp visit_func_call(node_id id) override {
+        const FuncCallNode& call = ast.func_call(id);
+        vector<Temp> temps;
+        for (uint32_t i = 0; i < call.num_args; i++) {
+            temps.push_back(visit(ast.call_arg(call, i)));
+        }
+        for (Temp t : temps) {
+            emit(Opcode::PARAM, Operand(), Operand::temp(t));
+        }
+        Temp ret = new_temp();
+        emit(Opcode::CALL, ret, name(OperandKind::FUNC, call.func_name), program.imm(temps.size()));
+        return ret;
+    }
+
+    // Statements
+
+    Temp visit_expr_stmt(node_id id) override {
+        visit(ast.expr_stmt(id).expr);
+        return Temp();
+    }
+
+    // Jumps to L if cond is true when sense is, false when it is not, and falls
+    // through otherwise. && and || skip their right operand as C does, ! swaps
+    // the sense and a relational operator branches on its operands directly.
+    void jump_if(node_id cond, int L, bool sense) {
+        switch (ast.kind(cond)) {
+        case NodeKind::NONE: // a for loop without a condition
+            if (sense) emit_label(Opcode::JUMP, L);
+            return;
+        case NodeKind::EXPR_STMT:
+            jump_if(ast.expr_stmt(cond).expr, L, sense);
+            return;
+        case NodeKind::CONST: {
+            const string& text = ast.str(ast.constant(cond).value);
+            char* end;
+            double v = strtod(text.c_str(), &end);
+            if (*end) break;
+            if ((v != 0) == sense) emit_label(Opcode::JUMP, L);
+            return;
+        }
+        case NodeKind::UNARY_OP: {
+            const UnaryOpNode& u = ast.unary_op(cond);
+            if (opcode(unary_ops, unary_opcode, u.op) != Opcode::NOT) break;
+            jump_if(u.expr, L, !sense);
+            return;
+        }
+        case NodeKind::BINARY_OP: {
+            const BinaryOpNode& b = ast.binary_op(cond);
+            Opcode op = opcode(binary_ops, binary_opcode, b.op);
+            if (op == Opcode::AND || op == Opcode::OR) {
+                // a && b jumps when both hold, or as soon as one fails; a || b the other way round
+                if (sense == (op == Opcode::OR)) {
+                    jump_if(b.left, L, sense);
+                    jump_if(b.right, L, sense);
+                } else {
+                    int Lskip = new_label();
+                    jump_if(b.left, Lskip, !sense);
+                    jump_if(b.right, L, sense);
+                    emit_label(Opcode::LABEL, Lskip);
+                }
+                return;
+            }
+            if (!is_relational(op)) break;
+            auto [lt, rt] = visit_operands(cond);
+            emit(branch_opcode(sense ? op : negate_relation(op)), Operand::label(L), Operand::temp(lt),
+                 Operand::temp(rt));
+            return;
+        }
+        default:
+            break;
+        }
+        Temp t = visit(cond);
+        if (sense) {
+            emit(Opcode::COND_JUMP, Operand(), Operand::temp(t), Operand::label(L));
+        } else {
+            Temp zero = new_temp();
+            emit(Opcode::MOV, zero, program.imm(0));
+            emit(Opcode::IF_EQ, Operand::label(L), Operand::temp(t), Operand::temp(zero));
+        }
+    }
+
+    Temp visit_if(node_id id) override {
+        const IfNode& s = ast.if_stmt(id);
+        int Lfalse = new_label();
+        jump_if(s.condition, Lfalse, false);
+        visit(s.then_block);
+        if (!s.else_block) {
+            emit_label(Opcode::LABEL, Lfalse);
+            return Temp();
+        }
+        int Lend = new_label();
+        emit_label(Opcode::JUMP, Lend);
+        emit_label(Opcode::LABEL, Lfalse);
+        visit(s.else_block);
+        emit_label(Opcode::LABEL, Lend);
+        return Temp();
+    }
+
+    // Loops are rotated: a guard skips the loop if the condition fails on
+    // entry, and the condition is tested again after the body, so each
+    // iteration takes a single branch back to the top
+    Temp visit_while(node_id id) override {
+        const WhileNode& s = ast.while_stmt(id);
+        int Lbody = new_label();
+        int Lend = new_label();
+        jump_if(s.condition, Lend, false);
+        emit_label(Opcode::LABEL, Lbody);
+        visit(s.body);
+        jump_if(s.condition, Lbody, true);
+        emit_label(Opcode::LABEL, Lend);
+        return Temp();
+    }
+
+    Temp visit_for(node_id id) override {
+        const ForNode& s = ast.for_stmt(id);
+        visit(s.init);
+        int Lbody = new_label();
+        int Lend = new_label();
+        jump_if(s.condition, Lend, false);
+        emit_label(Opcode::LABEL, Lbody);
+        visit(s.body);
+        visit(s.update);
+        jump_if(s.condition, Lbody, true);
+        emit_label(Opcode::LABEL, Lend);
+        return Temp();
+    }
+
+    Temp visit_return(node_id id) override {
+        Temp val = visit(ast.return_stmt(id).expr);
+        emit(Opcode::RETURN, Operand(), Operand::temp(val));
+        return val;
+    }
+
+    Temp visit_decl(node_id id) override {
+        const DeclNode& d = ast.decl(id);
+        for (uint32_t i = 0; i < d.num_vars; i++) {
+            const DeclVar& v = ast.decl_var(d, i);
+            if (!in_function) {
+                if (v.name >= global_names.size()) global_names.resize(v.name + 1);
+                global_names[v.name] = true;
+            }
+            string text = "Declaration: " + ast.str(d.type) + " " + ast.str(v.name);
+            if (v.array_size > 0) text += "[" + to_string(v.array_size) + "]";
+            comment(std::move(text));
+        }
+        return Temp();
+    }
+
+    Temp visit_func_decl(node_id id) override {
+        const FuncDeclNode& f = ast.func_decl(id);
+        program.units.emplace_back();
+        TacFunction& unit = program.units.back();
+        unit.name = name(OperandKind::FUNC, f.name).id;
+        unit.temp_base = temp_count;
+        unit.label_base = label_count;
+        in_function = true;
+
+        string text = "Function: " + ast.str(f.return_type) + " " + ast.str(f.name) + "(";
+        for (uint32_t i = 0; i < f.num_params; ++i) {
+            const Param& p = ast.param(f, i);
+            text += ast.str(p.type) + " " + ast.str(p.name);
+            if (i + 1 < f.num_params) text += ", ";
+        }
+        text += ")";
+        comment(std::move(text));
+        visit(f.body);
+
+        in_function = false;
+        program.units.back().code.assign(body.begin(), body.end());
+        body.clear();
+        program.units.back().temps = temp_count - program.units.back().temp_base;
+        program.units.back().labels = label_count - program.units.back().label_base;
+        set_variables(id, program.units.back());
+        return Temp();
+    }
+
+    // ARGUMENTS only carries call arguments while parsing
+    Temp visit_arguments(node_id) override { return Temp(); }
+};
+
+enum class TacFormat { TEXT, BINARY, COUNT };
+
+// Builds the IR of the program into ctx.tac. With a cache file, functions whose
+// code is cached are not generated again.
+class ThreeAddrCodePass : public Pass {
+private:
+    string cache_path;
+
+public:
+    explicit ThreeAddrCodePass(const string& cache_path = "") : cache_path(cache_path) {}
+
+    string name() const override { return "tac"; }
+    vector<string> dependencies() const override { return {"verify-ast"}; }
+
+    bool run(PassContext& ctx) override {
+        if (cache_path.empty()) {
+            ThreeAddrCodeGenerator(ctx.ast, ctx.tac).generate(ctx.root);
+            return true;
+        }
+
+        TacCache cache;
+        cache.load(cache_path);
+        ThreeAddrCodeGenerator(ctx.ast, ctx.tac).generate(ctx.root, &cache);
+        ctx.outlog << "TAC cache: " << cache.hits << " functions reused, " << cache.misses << " generated" << endl;
+        string reason;
+        if (!cache.save(cache_path, reason)) ctx.outlog << "TAC cache not saved: " << reason << endl;
+        return true;
+    }
+};
+
+// Prints the IR as code.txt, as binary records in code.bin, or only as
+// instruction counts (to the log) for a dry run. Passes over the IR run
+// between tac and this one.
+class TacPrintPass : public Pass {
+private:
+    TacFormat format;
+
+public:
+    explicit TacPrintPass(TacFormat format = TacFormat::TEXT) : format(format) {}
+
+    string name() const override { return "print-tac"; }
+    vector<string> dependencies() const override { return {"tac"}; }
+
+    bool run(PassContext& ctx) override {
+        if (format == TacFormat::TEXT) {
+            TextEmitter emit(ctx.outcode);
+            print_tac(ctx.tac, emit);
+        } else if (format == TacFormat::BINARY) {
+            ofstream out("code.bin", ios::binary | ios::trunc);
+            if (!out) {
+                ctx.outerror << "Cannot open code.bin for writing" << endl << endl;
+                return false;
+            }
+            BinaryEmitter emit(out);
+            print_tac(ctx.tac, emit);
+        } else {
+            CountingEmitter emit;
+            print_tac(ctx.tac, emit);
+            emit.print(ctx.outlog);
+        }
+        return true;
+    }
 };
 
 #endif // THREE_ADDR_CODE_H
@@ -0,0 +1,279 @@
+#ifndef XREF_INDEX_H
+#define XREF_INDEX_H
+
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Cross-reference index of a translation unit.
+//
+// Built while parsing: every symbol the parser declares gets an entry with its
+// kind, the line it is defined on and the scope it lives in, and every lookup
+// that resolves to it adds the line of the use. Recording is a push onto a
+// vector per event; sorting and grouping happen once, when the index is written.
+// Layout (native byte order, recorded in the header so an index from a machine
+// of the other order is refused):
+//
+//   xref_header
+//   xref_symbol [num_symbols]   sorted by name, then by definition line
+//   uint32_t    [num_uses]      use lines of symbol k are [first_use, first_use+num_uses), ascending
+//   char        [strtab_size]   names, not NUL terminated
+//
+// The file is mapped read-only and a query is a binary search over the symbols.
+
+const char XREF_MAGIC[4] = {'T', 'A', 'C', 'X'};
+const uint16_t XREF_VERSION = 2;
+const uint16_t XREF_BYTE_ORDER = 0x0102;
+
+struct xref_header
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t byte_order;
+    uint32_t num_symbols;
+    uint32_t num_uses;
+    uint32_t strtab_size;
+};
+
+struct xref_symbol
+{
+    uint32_t name_off;
+    uint16_t name_len;
+    uint8_t kind;
+    uint8_t reserved;
+    uint32_t def_line;   // 0 for functions imported from an interface
+    uint32_t scope;      // id of the scope table, 1 is the global scope
+    uint32_t first_use;
+    uint32_t num_uses;
+};
+
+static_assert(sizeof(xref_header) == 20, "xref header layout changed");
+static_assert(sizeof(xref_symbol) == 24, "xref symbol record layout changed");
+
+enum XrefKind : uint8_t { XREF_VAR, XREF_ARRAY, XREF_PARAM, XREF_FUNC, XREF_IMPORTED_FUNC, XREF_NUM_KINDS };
+
+const char *const XREF_KIND_NAMES[] = {"variable", "array", "parameter", "function", "imported function"};
+
+class XrefBuilder
+{
+private:
+    struct Definition
+    {
+        string name;
+        uint8_t kind;
+        uint32_t line, scope;
+    };
+
+    vector<Definition> defs;                 // indexed by the symbol's xref id
+    vector<pair<uint32_t, uint32_t>> uses;   // (xref id, line) in parse order
+
+public:
+    void define(symbol_info *sym, XrefKind kind, int line, int scope)
+    {
+        if (!sym) return;
+        sym->setxrefid(defs.size());
+        defs.push_back({sym->getname(), kind, (uint32_t)line, (uint32_t)scope});
+    }
+
+    // Lookups that found nothing are not recorded: there is no symbol to tie them to
+    void use(symbol_info *sym, int line)
+    {
+        if (sym && sym->getxrefid() >= 0) uses.emplace_back(sym->getxrefid(), line);
+    }
+
+    size_t num_symbols() const { return defs.size(); }
+    size_t num_uses() const { return uses.size(); }
+
+    // Returns false and sets reason on failure
+    bool write(const string &path, string &reason) const
+    {
+        // group the uses by symbol; parse order already sorts each group by line
+        vector<uint32_t> first(defs.size() + 1, 0);
+        for (auto &u : uses) first[u.first + 1]++;
+        for (size_t k = 0; k < defs.size(); k++) first[k + 1] += first[k];
+        vector<uint32_t> lines(uses.size());
+        vector<uint32_t> fill(first.begin(), first.end() - 1);
+        for (auto &u : uses) lines[fill[u.first]++] = u.second;
+
+        vector<uint32_t> order(defs.size());
+        for (size_t k = 0; k < order.size(); k++) order[k] = k;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            if (defs[a].name != defs[b].name) return defs[a].name < defs[b].name;
+            return defs[a].line < defs[b].line;
+        });
+
+        vector<xref_symbol> symbols;
+        symbols.reserve(defs.size());
+        string strtab;
+        for (uint32_t k : order)
+        {
+            const Definition &d = defs[k];
+            xref_symbol s = {};
+            // equal names are adjacent, so each one is stored once
+            if (!symbols.empty() && defs[order[symbols.size() - 1]].name == d.name)
+            {
+                s.name_off = symbols.back().name_off;
+            }
+            else
+            {
+                s.name_off = strtab.size();
+                strtab += d.name;
+            }
+            s.name_len = d.name.size();
+            s.kind = d.kind;
+            s.def_line = d.line;
+            s.scope = d.scope;
+            s.first_use = first[k];
+            s.num_uses = first[k + 1] - first[k];
+            symbols.push_back(s);
+        }
+
+        xref_header h = {};
+        memcpy(h.magic, XREF_MAGIC, sizeof(h.magic));
+        h.version = XREF_VERSION;
+        h.byte_order = XREF_BYTE_ORDER;
+        h.num_symbols = symbols.size();
+        h.num_uses = lines.size();
+        h.strtab_size = strtab.size();
+
+        ofstream out(path, ios::binary | ios::trunc);
+        if (!out)
+        {
+            reason = "cannot open " + path + " for writing";
+            return false;
+        }
+        out.write((const char *)&h, sizeof(h));
+        out.write((const char *)symbols.data(), symbols.size() * sizeof(xref_symbol));
+        out.write((const char *)lines.data(), lines.size() * sizeof(uint32_t));
+        out.write(strtab.data(), strtab.size());
+        if (!out)
+        {
+            reason = "write to " + path + " failed";
+            return false;
+        }
+        return true;
+    }
+};
+
+// A mapped index file
+class XrefIndex
+{
+private:
+    void *map = MAP_FAILED;
+    size_t size = 0;
+    const xref_symbol *symbols = nullptr;
+    const uint32_t *use_lines = nullptr;
+    const char *strtab = nullptr;
+    uint32_t num_symbols = 0;
+
+public:
+    XrefIndex() {}
+    XrefIndex(const XrefIndex &) = delete;
+    XrefIndex &operator=(const XrefIndex &) = delete;
+
+    ~XrefIndex()
+    {
+        if (map != MAP_FAILED) munmap(map, size);
+    }
+
+    // Returns false and sets reason if the file is unusable
+    bool open(const string &path, string &reason)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            reason = "cannot open " + path;
+            return false;
+        }
+        struct stat sb;
+        if (fstat(fd, &sb) != 0 || sb.st_size < (off_t)sizeof(xref_header))
+        {
+            close(fd);
+            reason = path + " is not a cross-reference index";
+            return false;
+        }
+        size = sb.st_size;
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+        {
+            reason = "cannot map " + path;
+            return false;
+        }
+
+        const char *base = (const char *)map;
+        xref_header h;
+        memcpy(&h, base, sizeof(h));
+        uint64_t expected = sizeof(xref_header) + (uint64_t)h.num_symbols * sizeof(xref_symbol) +
+                            (uint64_t)h.num_uses * sizeof(uint32_t) + h.strtab_size;
+        if (memcmp(h.magic, XREF_MAGIC, sizeof(h.magic)) != 0)
+        {
+            reason = path + " is not a cross-reference index";
+        }
+        else if (h.byte_order == (uint16_t)(XREF_BYTE_ORDER << 8 | XREF_BYTE_ORDER >> 8))
+        {
+            reason = path + " was written with a different byte order";
+        }
+        else if (h.version != XREF_VERSION)
+        {
+            reason = path + " has index version " + to_string(h.version) + ", expected " + to_string(XREF_VERSION);
+        }
+        else if (expected != size)
+        {
+            reason = path + " is truncated or corrupt";
+        }
+        if (!reason.empty()) return false;
+
+        symbols = (const xref_symbol *)(base + sizeof(xref_header));
+        use_lines = (const uint32_t *)(symbols + h.num_symbols);
+        strtab = (const char *)(use_lines + h.num_uses);
+        num_symbols = h.num_symbols;
+        for (uint32_t k = 0; k < num_symbols; k++)
+        {
+            const xref_symbol &s = symbols[k];
+            if ((uint64_t)s.name_off + s.name_len > h.strtab_size || (uint64_t)s.first_use + s.num_uses > h.num_uses)
+            {
+                reason = path + " is truncated or corrupt";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string_view name(const xref_symbol &s) const { return string_view(strtab + s.name_off, s.name_len); }
+
+    // Every symbol called name, in order of definition
+    pair<const xref_symbol *, const xref_symbol *> find(string_view name) const
+    {
+        auto less = [&](const xref_symbol &s, string_view n) { return this->name(s) < n; };
+        const xref_symbol *first = lower_bound(symbols, symbols + num_symbols, name, less);
+        const xref_symbol *last = first;
+        while (last != symbols + num_symbols && this->name(*last) == name) last++;
+        return {first, last};
+    }
+
+    const uint32_t *uses(const xref_symbol &s) const { return use_lines + s.first_use; }
+
+    void print(const xref_symbol &s, ostream &out) const
+    {
+        out << name(s) << ": " << XREF_KIND_NAMES[s.kind < XREF_NUM_KINDS ? s.kind : uint8_t(XREF_VAR)];
+        if (s.def_line) out << " defined at line " << s.def_line;
+        out << " in scope " << s.scope;
+        if (!s.num_uses) out << ", never used";
+        else out << ", used at line" << (s.num_uses > 1 ? "s " : " ");
+        for (uint32_t i = 0; i < s.num_uses; i++) out << (i ? ", " : "") << uses(s)[i];
+        out << endl;
+    }
+};
+
+#endif // XREF_INDEX_H
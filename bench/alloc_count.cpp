@@ -0,0 +1,107 @@
+// Allocation-count benchmark for the Lab4 symbol table and AST constructors.
+//
+// Replays the per-token work the parser does for an identifier reference
+// (lookup through the scope chain, reading name/type/kind, building a VarNode)
+// and reports how many heap allocations each step costs. Identifiers are longer
+// than the small-string buffer so every string copy shows up as an allocation.
+//
+// Build and run with bench/bench.sh
+
+#include "../Lab4-Intermediate_Code_Generation/Solution/symbol_table.h"
+#include "../Lab4-Intermediate_Code_Generation/Solution/ast.h"
+
+#include <cstdlib>
+#include <new>
+
+static size_t alloc_count = 0;
+
+void* operator new(size_t sz)
+{
+    alloc_count++;
+    if (void *p = malloc(sz ? sz : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+struct result
+{
+    string step;
+    size_t ops;
+    size_t allocs;
+};
+
+static void record(vector<result> &results, const char *step, size_t ops, size_t before)
+{
+    size_t allocs = alloc_count - before; // taken before the push_back allocates
+    results.push_back({step, ops, allocs});
+}
+
+int main()
+{
+    const int N = 2000;
+    ofstream devnull("/dev/null");
+
+    vector<string> names;
+    for (int i = 0; i < N; i++) names.push_back("identifier_with_long_name_" + to_string(i));
+
+    symbol_table table;
+    table.set_size(97);
+    table.enter_scope(devnull);
+
+    vector<result> results;
+    results.reserve(8);
+    size_t before;
+
+    before = alloc_count;
+    for (auto &n : names)
+    {
+        table.Insert_in_table(n, "ID");
+        symbol_info *sym = table.Lookup_in_table(n);
+        sym->setidtype("var");
+        sym->setvartype("int");
+    }
+    record(results, "insert + set kind/type", names.size(), before);
+
+    // duplicate inserts must not allocate a symbol that is then thrown away
+    before = alloc_count;
+    for (auto &n : names) table.Insert_in_table(n, "ID");
+    record(results, "duplicate insert", names.size(), before);
+
+    // identifier reference from a nested scope: lookup walks to the global scope
+    table.enter_scope(devnull);
+    table.enter_scope(devnull);
+    size_t checksum = 0;
+    before = alloc_count;
+    for (auto &n : names)
+    {
+        symbol_info *sym = table.Lookup_in_table(n);
+        checksum += sym->getname().size() + sym->getvartype().size() + sym->getidtype().size();
+    }
+    record(results, "lookup + getters", names.size(), before);
+
+    // VarNode for an identifier already seen: the arena has interned the name,
+    // and node storage grows geometrically, so this is amortised to ~0
+    ASTArena ast;
+    for (auto &n : names) ast.make_var(n, "int");
+    before = alloc_count;
+    for (auto &n : names)
+    {
+        ast.make_var(n, "int");
+    }
+    record(results, "VarNode, interned name", names.size(), before);
+
+    table.exit_scope(devnull);
+    table.exit_scope(devnull);
+
+    cout << left << setw(28) << "step" << right << setw(10) << "ops" << setw(12) << "allocs"
+         << setw(14) << "allocs/op" << endl;
+    for (auto &r : results)
+    {
+        cout << left << setw(28) << r.step << right << setw(10) << r.ops << setw(12) << r.allocs
+             << setw(14) << fixed << setprecision(2) << (double)r.allocs / r.ops << endl;
+    }
+    cout << "(checksum " << checksum << ")" << endl;
+
+    return 0;
+}
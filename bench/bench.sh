@@ -0,0 +1,9 @@
+#!/bin/bash
+
+g++ -std=c++17 -O2 -w -o alloc_count alloc_count.cpp
+echo 'Built the allocation-count benchmark'
+./alloc_count
+
+g++ -std=c++17 -O2 -w -o symtab_bench symtab_bench.cpp -lbenchmark -lpthread
+echo 'Built the symbol table benchmarks'
+./symtab_bench --benchmark_out=symtab_bench.json --benchmark_out_format=json "$@"
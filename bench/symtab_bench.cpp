@@ -0,0 +1,265 @@
+// Symbol table microbenchmarks.
+//
+// Drives insert, lookup, enter_scope and exit_scope of the Lab3 and Lab4 symbol
+// tables side by side, plus ScopedMap directly for every storage/hash policy
+// pair, over realistic and adversarial name distributions:
+//
+//   Realistic   functions with params, locals and nested loop scopes
+//   DeepNesting lookups from the bottom of a deep scope stack
+//   ManyGlobals thousands of globals looked up from a function scope
+//   Anagrams    permutations of one word; every name has the same char sum
+//   Shadowing   a loop body that re-declares the same names every iteration
+//
+// The Lab3/Lab4 tables log scope entry/exit to a stream (here /dev/null), so
+// the ScopedMap rows are the storage cost alone.
+//
+// Build and run with bench/bench.sh; JSON for regression tracking goes to
+// symtab_bench.json.
+
+#include <bits/stdc++.h>
+#include <benchmark/benchmark.h>
+
+#include "../common/scoped_map.h"
+
+// both labs define symbol_info/scope_table/symbol_table; keep them apart
+namespace lab3
+{
+#include "../Lab3-SemanticAnalysis/Solution/symbol_table.h"
+}
+namespace lab4
+{
+#include "../Lab4-Intermediate_Code_Generation/Solution/symbol_table.h"
+}
+
+using namespace std;
+
+static ofstream devnull("/dev/null");
+
+// ---------------------------------------------------------------------------
+// Adapters giving every implementation the same interface
+
+struct lab3_table
+{
+    lab3::symbol_table table{10};
+    void enter() { table.enter_scope(devnull); }
+    void exit() { table.exit_scope(devnull); }
+    bool insert(const string &name) { return table.insert(new lab3::symbol_info(name, "ID")); }
+    bool lookup(const string &name) { return table.lookup(string_view(name)) != NULL; }
+};
+
+struct lab4_table
+{
+    lab4::symbol_table table;
+    void enter() { table.enter_scope(devnull); }
+    void exit() { table.exit_scope(devnull); }
+    bool insert(const string &name) { return table.Insert_in_table(name, "ID"); }
+    bool lookup(const string &name) { return table.Lookup_in_table(name) != NULL; }
+};
+
+template <template <class, class, class> class Storage, class Hash>
+struct map_table
+{
+    ScopedMap<string, unique_ptr<lab4::symbol_info>, Hash, Storage> table;
+    void enter() { table.enter_scope(10); }
+    void exit() { table.exit_scope(); }
+    bool insert(const string &name)
+    {
+        return table.try_emplace(name, [&] { return make_unique<lab4::symbol_info>(name, "ID"); }) != nullptr;
+    }
+    bool lookup(const string &name) { return table.find(name) != nullptr; }
+};
+
+using chained_charsum = map_table<chained_storage, char_sum_hash>;
+using chained_fnv = map_table<chained_storage, fnv1a_hash>;
+using open_charsum = map_table<open_addressing_storage, char_sum_hash>;
+using open_fnv = map_table<open_addressing_storage, fnv1a_hash>;
+using binding_charsum = map_table<binding_stack_storage, char_sum_hash>;
+using binding_fnv = map_table<binding_stack_storage, fnv1a_hash>;
+
+// ---------------------------------------------------------------------------
+// Name sets, built once outside the timed regions
+
+static vector<string> numbered(const string &prefix, int n)
+{
+    vector<string> names;
+    for (int i = 0; i < n; i++) names.push_back(prefix + to_string(i));
+    return names;
+}
+
+static const vector<string> &anagrams()
+{
+    static vector<string> names = []
+    {
+        vector<string> v;
+        string s = "abcdefgh";
+        do v.push_back(s);
+        while (next_permutation(s.begin(), s.end()) && v.size() < 4096);
+        return v;
+    }();
+    return names;
+}
+
+// ---------------------------------------------------------------------------
+// Workloads
+
+// n functions of realistic shape: 2 params, 6 locals, two nested loop scopes,
+// and lookups biased towards locals the way expression code is
+template <class T>
+static void BM_Realistic(benchmark::State &state)
+{
+    int funcs = state.range(0);
+    vector<string> fnames = numbered("func", funcs);
+    vector<string> globals = numbered("g", 16);
+    vector<string> locals = {"a", "b", "c", "i", "j", "k", "sum", "tmp"};
+    int64_t ops = 0;
+
+    for (auto _ : state)
+    {
+        T t;
+        t.enter();
+        for (auto &g : globals) t.insert(g);
+        for (int f = 0; f < funcs; f++)
+        {
+            t.insert(fnames[f]);
+            t.enter();
+            for (auto &l : locals) t.insert(l);
+            for (int loop = 0; loop < 2; loop++)
+            {
+                t.enter();
+                t.insert("x");
+                t.insert("y");
+                for (int k = 0; k < 4; k++)
+                {
+                    benchmark::DoNotOptimize(t.lookup("x"));
+                    benchmark::DoNotOptimize(t.lookup(locals[(f + k) % locals.size()]));
+                    benchmark::DoNotOptimize(t.lookup(globals[(f + k) % globals.size()]));
+                }
+                benchmark::DoNotOptimize(t.lookup(fnames[f / 2]));
+                t.exit();
+            }
+            t.exit();
+        }
+        t.exit();
+        ops += globals.size() + 2 + funcs * (3 + locals.size() + 2 * 17);
+    }
+    state.SetItemsProcessed(ops);
+}
+
+// globals resolved from the innermost of depth nested scopes, each holding a few locals
+template <class T>
+static void BM_DeepNesting(benchmark::State &state)
+{
+    int depth = state.range(0);
+    vector<string> globals = numbered("global", 32);
+    vector<vector<string>> locals;
+    for (int d = 0; d < depth; d++) locals.push_back(numbered("l" + to_string(d) + "_", 4));
+    int64_t ops = 0;
+
+    for (auto _ : state)
+    {
+        T t;
+        t.enter();
+        for (auto &g : globals) t.insert(g);
+        for (int d = 0; d < depth; d++)
+        {
+            t.enter();
+            for (auto &l : locals[d]) t.insert(l);
+        }
+        for (auto &g : globals) benchmark::DoNotOptimize(t.lookup(g));
+        for (int d = 0; d < depth; d++) benchmark::DoNotOptimize(t.lookup(locals[d][0]));
+        for (int d = 0; d <= depth; d++) t.exit();
+        ops += globals.size() * 2 + depth * (locals[0].size() + 3) + 2;
+    }
+    state.SetItemsProcessed(ops);
+}
+
+// n globals looked up from inside a function scope
+template <class T>
+static void BM_ManyGlobals(benchmark::State &state)
+{
+    int n = state.range(0);
+    vector<string> globals = numbered("global_var_", n);
+    int64_t ops = 0;
+
+    for (auto _ : state)
+    {
+        T t;
+        t.enter();
+        for (auto &g : globals) t.insert(g);
+        t.enter();
+        t.insert("a");
+        for (auto &g : globals) benchmark::DoNotOptimize(t.lookup(g));
+        t.exit();
+        t.exit();
+        ops += 2 * n + 5;
+    }
+    state.SetItemsProcessed(ops);
+}
+
+// n anagrams of one word: a single chain under the char-sum hash
+template <class T>
+static void BM_Anagrams(benchmark::State &state)
+{
+    int n = state.range(0);
+    const vector<string> &names = anagrams();
+    int64_t ops = 0;
+
+    for (auto _ : state)
+    {
+        T t;
+        t.enter();
+        for (int i = 0; i < n; i++) t.insert(names[i]);
+        for (int i = 0; i < n; i++) benchmark::DoNotOptimize(t.lookup(names[i]));
+        t.exit();
+        ops += 2 * n + 2;
+    }
+    state.SetItemsProcessed(ops);
+}
+
+// loop bodies that shadow the loop counters and read a few outer names
+template <class T>
+static void BM_Shadowing(benchmark::State &state)
+{
+    int iterations = state.range(0);
+    vector<string> outer = {"i", "j", "n", "a", "sum"};
+    int64_t ops = 0;
+
+    for (auto _ : state)
+    {
+        T t;
+        t.enter();
+        for (auto &o : outer) t.insert(o);
+        for (int it = 0; it < iterations; it++)
+        {
+            t.enter();
+            t.insert("i");
+            t.insert("j");
+            for (int k = 0; k < 4; k++)
+            {
+                for (auto &o : outer) benchmark::DoNotOptimize(t.lookup(o));
+            }
+            t.exit();
+        }
+        t.exit();
+        ops += outer.size() + iterations * (4 + 4 * outer.size()) + 2;
+    }
+    state.SetItemsProcessed(ops);
+}
+
+#define SYMTAB_BENCHMARK(workload, arg)                         \
+    BENCHMARK_TEMPLATE(workload, lab3_table)->Arg(arg);         \
+    BENCHMARK_TEMPLATE(workload, lab4_table)->Arg(arg);         \
+    BENCHMARK_TEMPLATE(workload, chained_charsum)->Arg(arg);    \
+    BENCHMARK_TEMPLATE(workload, chained_fnv)->Arg(arg);        \
+    BENCHMARK_TEMPLATE(workload, open_charsum)->Arg(arg);       \
+    BENCHMARK_TEMPLATE(workload, open_fnv)->Arg(arg);           \
+    BENCHMARK_TEMPLATE(workload, binding_charsum)->Arg(arg);    \
+    BENCHMARK_TEMPLATE(workload, binding_fnv)->Arg(arg)
+
+SYMTAB_BENCHMARK(BM_Realistic, 200);
+SYMTAB_BENCHMARK(BM_DeepNesting, 64);
+SYMTAB_BENCHMARK(BM_ManyGlobals, 4096);
+SYMTAB_BENCHMARK(BM_Anagrams, 2048);
+SYMTAB_BENCHMARK(BM_Shadowing, 1000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,554 @@
+#ifndef SCOPED_MAP_H
+#define SCOPED_MAP_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Scoped symbol map shared by the symbol tables of every lab.
+//
+//   ScopedMap<Key, Value, HashPolicy, StoragePolicy>
+//
+// Keys are bound in the innermost open scope; lookups resolve to the innermost
+// binding and report how many scopes out it was found. Exiting a scope destroys
+// everything bound in it. The hash and the storage layout are template
+// parameters, so the lookup paths are specialised and inlined for the chosen
+// combination:
+//
+//   chained_storage        per-scope bucket array with chains threaded through the entries
+//   open_addressing_storage per-scope linear-probing slot array
+//   binding_stack_storage  one table of names, each pointing at its innermost binding;
+//                          a lookup is a single probe however deep the scope stack is
+//
+// All storages keep the entries of every open scope in one vector, innermost
+// scope last, so entering/exiting a scope is a push/pop and a scope can be walked
+// in insertion order. Value pointers returned by lookups stay valid until the
+// next insertion.
+
+// ---------------------------------------------------------------------------
+// Hash policies: callable with the key type and with every lookup key type used
+
+// character sum, the hash the labs were written against
+struct char_sum_hash
+{
+    size_t operator()(string_view s) const
+    {
+        size_t sum = 0;
+        for (char c : s) sum += c;
+        return sum;
+    }
+};
+
+// 64-bit FNV-1a, spreads anagrams and short identifiers that collide under the char sum
+struct fnv1a_hash
+{
+    size_t operator()(string_view s) const
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (unsigned char c : s)
+        {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+};
+
+// filled in by lookups on request; depth 0 is the innermost scope
+struct scoped_lookup_info
+{
+    int depth = 0;
+    int probes = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Entry stack common to all storages
+
+template <class Key, class Value>
+struct scoped_entry
+{
+    Key key;
+    Value value;
+    size_t hash;
+    uint32_t link;  // chain successor (chained) or shadowed binding (binding stack)
+    uint32_t level; // scope the entry was bound in
+    bool live;      // false once erased; the slot is reclaimed when its scope exits
+};
+
+template <class Key, class Value>
+class scoped_entry_stack
+{
+protected:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    vector<scoped_entry<Key, Value>> entries; // every open scope, innermost last
+    vector<uint32_t> marks;                   // marks[l] = index of the first entry of level l
+
+    uint32_t push_entry(Key key, Value value, size_t hash, uint32_t link)
+    {
+        entries.push_back({std::move(key), std::move(value), hash, link, (uint32_t)marks.size() - 1, true});
+        return entries.size() - 1;
+    }
+
+    uint32_t scope_begin(size_t level) const { return marks[level]; }
+    uint32_t scope_end(size_t level) const { return level + 1 < marks.size() ? marks[level + 1] : entries.size(); }
+
+    void pop_entries()
+    {
+        entries.erase(entries.begin() + marks.back(), entries.end());
+        marks.pop_back();
+    }
+
+public:
+    // number of open scopes; the innermost is depth()-1
+    size_t depth() const { return marks.size(); }
+
+    // live entries of one scope in insertion order, as f(const Key&, Value&)
+    template <class F>
+    void for_each_in_scope(size_t level, F f)
+    {
+        for (uint32_t i = scope_begin(level), e = scope_end(level); i < e; i++)
+        {
+            if (entries[i].live) f(entries[i].key, entries[i].value);
+        }
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Chained storage
+
+template <class Key, class Value, class Hash>
+class chained_storage : public scoped_entry_stack<Key, Value>
+{
+private:
+    using base = scoped_entry_stack<Key, Value>;
+    using base::NONE;
+    using base::entries;
+    using base::marks;
+
+    struct scope_index
+    {
+        uint32_t first_bucket;
+        uint32_t mask;
+    };
+
+    vector<uint32_t> heads; // bucket heads of every open scope, innermost last
+    vector<scope_index> scopes;
+    Hash hasher;
+
+    template <class K>
+    uint32_t find_in(size_t level, const K &key, size_t h, scoped_lookup_info *info) const
+    {
+        const scope_index &s = scopes[level];
+        for (uint32_t i = heads[s.first_bucket + (h & s.mask)]; i != NONE; i = entries[i].link)
+        {
+            if (info) info->probes++;
+            if (entries[i].hash == h && entries[i].key == key) return i;
+        }
+        return NONE;
+    }
+
+public:
+    void enter_scope(size_t buckets)
+    {
+        uint32_t n = 1;
+        while (n < buckets) n <<= 1;
+        scopes.push_back({(uint32_t)heads.size(), n - 1});
+        heads.resize(heads.size() + n, NONE);
+        marks.push_back(entries.size());
+    }
+
+    void exit_scope()
+    {
+        heads.resize(scopes.back().first_bucket);
+        scopes.pop_back();
+        this->pop_entries();
+    }
+
+    template <class K>
+    Value *find(const K &key, scoped_lookup_info *info = nullptr)
+    {
+        size_t h = hasher(key);
+        for (size_t level = scopes.size(); level-- > 0;)
+        {
+            uint32_t i = find_in(level, key, h, info);
+            if (i != NONE)
+            {
+                if (info) info->depth = scopes.size() - 1 - level;
+                return &entries[i].value;
+            }
+        }
+        if (info) info->depth = scopes.size() - 1;
+        return nullptr;
+    }
+
+    template <class K>
+    Value *find_local(const K &key)
+    {
+        uint32_t i = find_in(scopes.size() - 1, key, hasher(key), nullptr);
+        return i == NONE ? nullptr : &entries[i].value;
+    }
+
+    // binds key in the innermost scope to make(), unless it is already bound there
+    template <class K, class F>
+    Value *try_emplace(const K &key, F make)
+    {
+        size_t h = hasher(key);
+        uint32_t bucket = scopes.back().first_bucket + (h & scopes.back().mask);
+        uint32_t last = NONE;
+        for (uint32_t i = heads[bucket]; i != NONE; i = entries[i].link)
+        {
+            if (entries[i].hash == h && entries[i].key == key) return nullptr;
+            last = i;
+        }
+        // append so each chain stays in insertion order
+        uint32_t i = this->push_entry(Key(key), make(), h, NONE);
+        if (last == NONE) heads[bucket] = i;
+        else entries[last].link = i;
+        return &entries[i].value;
+    }
+
+    template <class K>
+    bool erase_local(const K &key)
+    {
+        size_t h = hasher(key);
+        const scope_index &s = scopes.back();
+        uint32_t *link = &heads[s.first_bucket + (h & s.mask)];
+        while (*link != NONE)
+        {
+            auto &e = entries[*link];
+            if (e.hash == h && e.key == key)
+            {
+                *link = e.link;
+                e.live = false;
+                e.value = Value();
+                return true;
+            }
+            link = &e.link;
+        }
+        return false;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Open addressing storage
+
+template <class Key, class Value, class Hash>
+class open_addressing_storage : public scoped_entry_stack<Key, Value>
+{
+private:
+    using base = scoped_entry_stack<Key, Value>;
+    using base::NONE;
+    using base::entries;
+    using base::marks;
+
+    static constexpr uint32_t TOMB = UINT32_MAX - 1;
+
+    struct scope_index
+    {
+        uint32_t first_slot;
+        uint32_t mask;
+        uint32_t used; // live entries plus tombstones
+    };
+
+    vector<uint32_t> slots; // slot arrays of every open scope, innermost last
+    vector<scope_index> scopes;
+    Hash hasher;
+
+    // slot holding key in level, or the first free slot of its probe sequence if absent
+    template <class K>
+    uint32_t probe(size_t level, const K &key, size_t h, bool &found, scoped_lookup_info *info) const
+    {
+        const scope_index &s = scopes[level];
+        uint32_t free_slot = NONE;
+        for (uint32_t p = h & s.mask;; p = (p + 1) & s.mask)
+        {
+            uint32_t i = slots[s.first_slot + p];
+            if (info) info->probes++;
+            if (i == NONE)
+            {
+                found = false;
+                return s.first_slot + (free_slot != NONE ? free_slot : p);
+            }
+            if (i == TOMB)
+            {
+                if (free_slot == NONE) free_slot = p;
+            }
+            else if (entries[i].hash == h && entries[i].key == key)
+            {
+                found = true;
+                return s.first_slot + p;
+            }
+        }
+    }
+
+    // the innermost scope owns the tail of slots, so it can be rebuilt in place
+    void grow()
+    {
+        scope_index &s = scopes.back();
+        uint32_t n = (s.mask + 1) * 2;
+        slots.resize(s.first_slot);
+        slots.resize(s.first_slot + n, NONE);
+        s.mask = n - 1;
+        s.used = 0;
+        for (uint32_t i = marks.back(); i < entries.size(); i++)
+        {
+            if (!entries[i].live) continue;
+            uint32_t p = entries[i].hash & s.mask;
+            while (slots[s.first_slot + p] != NONE) p = (p + 1) & s.mask;
+            slots[s.first_slot + p] = i;
+            s.used++;
+        }
+    }
+
+public:
+    void enter_scope(size_t buckets)
+    {
+        uint32_t n = 4;
+        while (n < buckets * 2) n <<= 1; // keep the initial load under one half
+        scopes.push_back({(uint32_t)slots.size(), n - 1, 0});
+        slots.resize(slots.size() + n, NONE);
+        marks.push_back(entries.size());
+    }
+
+    void exit_scope()
+    {
+        slots.resize(scopes.back().first_slot);
+        scopes.pop_back();
+        this->pop_entries();
+    }
+
+    template <class K>
+    Value *find(const K &key, scoped_lookup_info *info = nullptr)
+    {
+        size_t h = hasher(key);
+        for (size_t level = scopes.size(); level-- > 0;)
+        {
+            bool found;
+            uint32_t slot = probe(level, key, h, found, info);
+            if (found)
+            {
+                if (info) info->depth = scopes.size() - 1 - level;
+                return &entries[slots[slot]].value;
+            }
+        }
+        if (info) info->depth = scopes.size() - 1;
+        return nullptr;
+    }
+
+    template <class K>
+    Value *find_local(const K &key)
+    {
+        bool found;
+        uint32_t slot = probe(scopes.size() - 1, key, hasher(key), found, nullptr);
+        return found ? &entries[slots[slot]].value : nullptr;
+    }
+
+    template <class K, class F>
+    Value *try_emplace(const K &key, F make)
+    {
+        size_t h = hasher(key);
+        bool found;
+        uint32_t slot = probe(scopes.size() - 1, key, h, found, nullptr);
+        if (found) return nullptr;
+
+        uint32_t i = this->push_entry(Key(key), make(), h, NONE);
+        scope_index &s = scopes.back();
+        if (slots[slot] == NONE) s.used++;
+        slots[slot] = i;
+        if ((s.used + 1) * 4 > (s.mask + 1) * 3) grow(); // load factor 3/4
+        return &entries[i].value;
+    }
+
+    template <class K>
+    bool erase_local(const K &key)
+    {
+        bool found;
+        uint32_t slot = probe(scopes.size() - 1, key, hasher(key), found, nullptr);
+        if (!found) return false;
+        auto &e = entries[slots[slot]];
+        e.live = false;
+        e.value = Value();
+        slots[slot] = TOMB;
+        return true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Binding stack storage
+
+template <class Key, class Value, class Hash>
+class binding_stack_storage : public scoped_entry_stack<Key, Value>
+{
+private:
+    using base = scoped_entry_stack<Key, Value>;
+    using base::NONE;
+    using base::entries;
+    using base::marks;
+
+    // every name ever bound, interned; names are never removed
+    vector<uint32_t> name_slots; // open addressing over name ids
+    vector<Key> names;
+    vector<size_t> name_hashes;
+    vector<uint32_t> bindings;    // innermost live binding of each name, or NONE
+    vector<uint32_t> entry_names; // name id of each entry
+    Hash hasher;
+
+    template <class K>
+    uint32_t find_name(const K &key, size_t h, uint32_t &slot, scoped_lookup_info *info) const
+    {
+        uint32_t mask = name_slots.size() - 1;
+        for (uint32_t p = h & mask;; p = (p + 1) & mask)
+        {
+            uint32_t id = name_slots[p];
+            if (info) info->probes++;
+            if (id == NONE)
+            {
+                slot = p;
+                return NONE;
+            }
+            if (name_hashes[id] == h && names[id] == key) return id;
+        }
+    }
+
+    template <class K>
+    uint32_t intern(const K &key, size_t h)
+    {
+        uint32_t slot;
+        uint32_t id = find_name(key, h, slot, nullptr);
+        if (id != NONE) return id;
+
+        id = names.size();
+        names.emplace_back(key);
+        name_hashes.push_back(h);
+        bindings.push_back(NONE);
+        name_slots[slot] = id;
+        if (names.size() * 4 > name_slots.size() * 3) rehash_names();
+        return id;
+    }
+
+    void rehash_names()
+    {
+        name_slots.assign(name_slots.size() * 2, NONE);
+        uint32_t mask = name_slots.size() - 1;
+        for (uint32_t id = 0; id < names.size(); id++)
+        {
+            uint32_t p = name_hashes[id] & mask;
+            while (name_slots[p] != NONE) p = (p + 1) & mask;
+            name_slots[p] = id;
+        }
+    }
+
+    template <class K>
+    uint32_t innermost(const K &key, scoped_lookup_info *info) const
+    {
+        uint32_t slot;
+        uint32_t id = find_name(key, hasher(key), slot, info);
+        return id == NONE ? NONE : bindings[id];
+    }
+
+public:
+    binding_stack_storage() : name_slots(64, NONE) {}
+
+    template <class F>
+    void for_each_in_scope(size_t level, F f)
+    {
+        for (uint32_t i = this->scope_begin(level), e = this->scope_end(level); i < e; i++)
+        {
+            if (entries[i].live) f(names[entry_names[i]], entries[i].value);
+        }
+    }
+
+    void enter_scope(size_t)
+    {
+        marks.push_back(entries.size());
+    }
+
+    void exit_scope()
+    {
+        // unwind in reverse so each name falls back to the binding it shadowed
+        for (uint32_t i = entries.size(); i-- > marks.back();)
+        {
+            if (entries[i].live) bindings[entry_names[i]] = entries[i].link;
+        }
+        entry_names.resize(marks.back());
+        this->pop_entries();
+    }
+
+    template <class K>
+    Value *find(const K &key, scoped_lookup_info *info = nullptr)
+    {
+        uint32_t i = innermost(key, info);
+        if (i == NONE)
+        {
+            if (info) info->depth = marks.size() - 1;
+            return nullptr;
+        }
+        if (info) info->depth = marks.size() - 1 - entries[i].level;
+        return &entries[i].value;
+    }
+
+    // number of open bindings of key: 1 for the innermost plus one per binding it shadows
+    template <class K>
+    int binding_depth(const K &key) const
+    {
+        int n = 0;
+        for (uint32_t i = innermost(key, nullptr); i != NONE; i = entries[i].link) n++;
+        return n;
+    }
+
+    template <class K>
+    Value *find_local(const K &key)
+    {
+        uint32_t i = innermost(key, nullptr);
+        return i != NONE && entries[i].level == marks.size() - 1 ? &entries[i].value : nullptr;
+    }
+
+    template <class K, class F>
+    Value *try_emplace(const K &key, F make)
+    {
+        size_t h = hasher(key);
+        uint32_t id = intern(key, h);
+        uint32_t prev = bindings[id];
+        if (prev != NONE && entries[prev].level == marks.size() - 1) return nullptr;
+
+        // the key lives in names[id]; entries of this storage leave theirs empty
+        uint32_t i = this->push_entry(Key(), make(), h, prev);
+        entry_names.push_back(id);
+        bindings[id] = i;
+        return &entries[i].value;
+    }
+
+    template <class K>
+    bool erase_local(const K &key)
+    {
+        uint32_t slot;
+        uint32_t id = find_name(key, hasher(key), slot, nullptr);
+        if (id == NONE) return false;
+        uint32_t i = bindings[id];
+        if (i == NONE || entries[i].level != marks.size() - 1) return false;
+        bindings[id] = entries[i].link;
+        entries[i].live = false;
+        entries[i].value = Value();
+        return true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+
+template <class Key, class Value, class HashPolicy = fnv1a_hash,
+          template <class, class, class> class StoragePolicy = binding_stack_storage>
+class ScopedMap : public StoragePolicy<Key, Value, HashPolicy>
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using hash_policy = HashPolicy;
+    using storage_policy = StoragePolicy<Key, Value, HashPolicy>;
+};
+
+#endif // SCOPED_MAP_H